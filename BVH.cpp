@@ -0,0 +1,429 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+//local (to this file) helpers used to build + query BVHs:
+namespace {
+	constexpr uint32_t const BinCount = 16; //split candidates per axis during build
+	constexpr uint32_t const MaxStack = 64; //traversal stack size
+	constexpr uint32_t const MedianDepth = 40; //past this depth, build splits at the median (keeps depth < MaxStack)
+
+	float half_area(glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	struct Builder {
+		BVH &bvh;
+
+		//per-triangle bounds:
+		struct Prim {
+			glm::vec3 min, max, centroid;
+		};
+		std::vector< Prim > prims;
+		std::vector< uint32_t > order; //triangles in leaf order
+
+		//build the subtree for order[begin,end); returns its node index:
+		uint32_t build(uint32_t begin, uint32_t end, uint32_t depth) {
+			uint32_t index = uint32_t(bvh.nodes.size());
+			bvh.nodes.emplace_back();
+
+			glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+			glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+			glm::vec3 cmin = min, cmax = max;
+			for (uint32_t i = begin; i < end; ++i) {
+				Prim const &p = prims[order[i]];
+				min = glm::min(min, p.min);
+				max = glm::max(max, p.max);
+				cmin = glm::min(cmin, p.centroid);
+				cmax = glm::max(cmax, p.centroid);
+			}
+			bvh.nodes[index].min = min;
+			bvh.nodes[index].max = max;
+
+			uint32_t count = end - begin;
+			if (count <= BVH::MaxLeafTriangles) {
+				bvh.nodes[index].first = begin;
+				bvh.nodes[index].count = count;
+				return index;
+			}
+
+			uint32_t mid = begin;
+			if (depth < MedianDepth) mid = sah_split(begin, end, cmin, cmax);
+			if (mid == begin || mid == end) {
+				//no useful SAH split (or too deep); split at the median along the widest centroid axis:
+				glm::vec3 extent = cmax - cmin;
+				int axis = (extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2));
+				mid = begin + count / 2;
+				std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+					return prims[a].centroid[axis] < prims[b].centroid[axis];
+				});
+			}
+
+			build(begin, mid, depth + 1); //(first child always directly follows its parent)
+			uint32_t second = build(mid, end, depth + 1);
+			bvh.nodes[index].first = second;
+			bvh.nodes[index].count = 0;
+			return index;
+		}
+
+		//binned surface area heuristic; returns partition point (or 'begin' if no split helps):
+		uint32_t sah_split(uint32_t begin, uint32_t end, glm::vec3 const &cmin, glm::vec3 const &cmax) {
+			struct Bin {
+				glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t count = 0;
+			};
+
+			float best_cost = std::numeric_limits< float >::infinity();
+			int best_axis = -1;
+			uint32_t best_bin = 0;
+
+			for (int axis = 0; axis < 3; ++axis) {
+				float extent = cmax[axis] - cmin[axis];
+				if (!(extent > 0.0f)) continue;
+				float scale = BinCount / extent;
+
+				std::array< Bin, BinCount > bins;
+				for (uint32_t i = begin; i < end; ++i) {
+					Prim const &p = prims[order[i]];
+					uint32_t b = std::min(BinCount - 1, uint32_t((p.centroid[axis] - cmin[axis]) * scale));
+					bins[b].min = glm::min(bins[b].min, p.min);
+					bins[b].max = glm::max(bins[b].max, p.max);
+					bins[b].count += 1;
+				}
+
+				//sweep from the right to get costs of everything right of each split:
+				std::array< float, BinCount > right_cost;
+				Bin acc;
+				for (uint32_t b = BinCount - 1; b > 0; --b) {
+					acc.min = glm::min(acc.min, bins[b].min);
+					acc.max = glm::max(acc.max, bins[b].max);
+					acc.count += bins[b].count;
+					right_cost[b] = acc.count ? acc.count * half_area(acc.min, acc.max) : 0.0f;
+				}
+				//..then from the left, combining:
+				acc = Bin();
+				for (uint32_t b = 0; b + 1 < BinCount; ++b) {
+					acc.min = glm::min(acc.min, bins[b].min);
+					acc.max = glm::max(acc.max, bins[b].max);
+					acc.count += bins[b].count;
+					float cost = (acc.count ? acc.count * half_area(acc.min, acc.max) : 0.0f) + right_cost[b + 1];
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin = b;
+					}
+				}
+			}
+
+			if (best_axis < 0) return begin;
+
+			float scale = BinCount / (cmax[best_axis] - cmin[best_axis]);
+			auto mid = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t) {
+				return std::min(BinCount - 1, uint32_t((prims[t].centroid[best_axis] - cmin[best_axis]) * scale)) <= best_bin;
+			});
+			return uint32_t(mid - order.begin());
+		}
+	};
+
+	//ray vs box; returns entry distance (or infinity if missed or farther than t_max):
+	inline float ray_box(glm::vec3 const &origin, glm::vec3 const &inv_direction, float t_max, BVH::Node const &node) {
+		glm::vec3 t0 = (node.min - origin) * inv_direction;
+		glm::vec3 t1 = (node.max - origin) * inv_direction;
+		glm::vec3 t_in = glm::min(t0, t1);
+		glm::vec3 t_out = glm::max(t0, t1);
+		float enter = std::max(std::max(t_in.x, t_in.y), std::max(t_in.z, 0.0f));
+		float exit = std::min(std::min(t_out.x, t_out.y), std::min(t_out.z, t_max));
+		return (enter <= exit ? enter : std::numeric_limits< float >::infinity());
+	}
+
+	inline bool box_box(glm::vec3 const &amin, glm::vec3 const &amax, glm::vec3 const &bmin, glm::vec3 const &bmax) {
+		return amin.x <= bmax.x && bmin.x <= amax.x
+		    && amin.y <= bmax.y && bmin.y <= amax.y
+		    && amin.z <= bmax.z && bmin.z <= amax.z;
+	}
+
+	//closest point on triangle abc to p (from Ericson, "Real-Time Collision Detection" 5.1.5):
+	glm::vec3 closest_point_on_triangle(glm::vec3 const &p, glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+		glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+		glm::vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+		glm::vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	bool triangle_sphere(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c, glm::vec3 const &center, float radius) {
+		glm::vec3 d = closest_point_on_triangle(center, a, b, c) - center;
+		return glm::dot(d, d) <= radius * radius;
+	}
+
+	//separating axis test of triangle vs box (Akenine-Moller, "Fast 3D Triangle-Box Overlap Testing"):
+	bool triangle_box(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 center = 0.5f * (min + max);
+		glm::vec3 half = 0.5f * (max - min);
+		a -= center; b -= center; c -= center;
+
+		//box face normals:
+		if (std::max({a.x, b.x, c.x}) < -half.x || std::min({a.x, b.x, c.x}) > half.x) return false;
+		if (std::max({a.y, b.y, c.y}) < -half.y || std::min({a.y, b.y, c.y}) > half.y) return false;
+		if (std::max({a.z, b.z, c.z}) < -half.z || std::min({a.z, b.z, c.z}) > half.z) return false;
+
+		//edge cross products:
+		glm::vec3 edges[3] = { b - a, c - b, a - c };
+		for (auto const &e : edges) {
+			for (int i = 0; i < 3; ++i) {
+				glm::vec3 axis = glm::vec3(0.0f);
+				axis[(i + 1) % 3] = -e[(i + 2) % 3];
+				axis[(i + 2) % 3] =  e[(i + 1) % 3];
+				float pa = glm::dot(a, axis), pb = glm::dot(b, axis), pc = glm::dot(c, axis);
+				float r = glm::dot(half, glm::abs(axis));
+				if (std::max({pa, pb, pc}) < -r || std::min({pa, pb, pc}) > r) return false;
+			}
+		}
+
+		//triangle normal:
+		glm::vec3 n = glm::cross(edges[0], edges[1]);
+		float r = glm::dot(half, glm::abs(n));
+		return std::abs(glm::dot(n, a)) <= r;
+	}
+
+	//visit leaves whose boxes pass 'box_test' until 'triangle_test' returns true:
+	template< typename BoxTest, typename TriangleTest >
+	bool any_overlap(BVH const &bvh, BoxTest const &box_test, TriangleTest const &triangle_test) {
+		if (bvh.nodes.empty()) return false;
+		uint32_t stack[MaxStack];
+		uint32_t top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			BVH::Node const &node = bvh.nodes[stack[--top]];
+			if (!box_test(node.min, node.max)) continue;
+			if (node.count) {
+				for (uint32_t t = node.first; t < node.first + node.count; ++t) {
+					if (triangle_test(bvh.positions[3*t+0], bvh.positions[3*t+1], bvh.positions[3*t+2])) return true;
+				}
+			} else {
+				stack[top++] = node.first;
+				stack[top++] = uint32_t(&node - &bvh.nodes[0]) + 1;
+			}
+		}
+		return false;
+	}
+
+	//bounds (in the space 'xf' maps to) of the box center +/- half:
+	void transform_box(glm::mat4x3 const &xf, glm::vec3 const &center, glm::vec3 const &half, glm::vec3 *min, glm::vec3 *max) {
+		glm::vec3 c = xf * glm::vec4(center, 1.0f);
+		glm::vec3 h = glm::abs(xf[0]) * half.x + glm::abs(xf[1]) * half.y + glm::abs(xf[2]) * half.z;
+		*min = c - h;
+		*max = c + h;
+	}
+}
+
+BVH::BVH(std::vector< glm::vec3 > const &triangle_positions) {
+	if (triangle_positions.size() % 3 != 0) {
+		throw std::runtime_error("BVH triangle positions should come in groups of three (got " + std::to_string(triangle_positions.size()) + ").");
+	}
+	uint32_t count = uint32_t(triangle_positions.size() / 3);
+	if (count == 0) return;
+
+	Builder builder{ *this };
+	builder.prims.resize(count);
+	for (uint32_t t = 0; t < count; ++t) {
+		glm::vec3 const &a = triangle_positions[3*t+0];
+		glm::vec3 const &b = triangle_positions[3*t+1];
+		glm::vec3 const &c = triangle_positions[3*t+2];
+		auto &p = builder.prims[t];
+		p.min = glm::min(a, glm::min(b, c));
+		p.max = glm::max(a, glm::max(b, c));
+		p.centroid = 0.5f * (p.min + p.max);
+	}
+	builder.order.resize(count);
+	std::iota(builder.order.begin(), builder.order.end(), 0);
+
+	nodes.reserve(2 * count - 1);
+	builder.build(0, count, 0);
+
+	//store triangles in leaf order:
+	triangles = std::move(builder.order);
+	positions.resize(triangle_positions.size());
+	for (uint32_t t = 0; t < count; ++t) {
+		positions[3*t+0] = triangle_positions[3*triangles[t]+0];
+		positions[3*t+1] = triangle_positions[3*triangles[t]+1];
+		positions[3*t+2] = triangle_positions[3*triangles[t]+2];
+	}
+}
+
+bool BVH::ray_cast(glm::vec3 const &origin, glm::vec3 const &direction, float t_max, RayHit *hit) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 inv_direction = 1.0f / direction;
+	float best_t = t_max;
+	uint32_t best = -1U;
+
+	//stack of (node, entry distance) still to visit:
+	struct Entry {
+		uint32_t node;
+		float t;
+	};
+	Entry stack[MaxStack];
+	uint32_t top = 0;
+
+	float t_root = ray_box(origin, inv_direction, best_t, nodes[0]);
+	if (t_root == std::numeric_limits< float >::infinity()) return false;
+	stack[top++] = Entry{ 0, t_root };
+
+	while (top > 0) {
+		Entry entry = stack[--top];
+		if (entry.t > best_t) continue; //(something closer was found since this was pushed)
+		uint32_t at = entry.node;
+
+		while (true) {
+			Node const &node = nodes[at];
+			if (node.count) {
+				//Moller-Trumbore ray/triangle intersection:
+				for (uint32_t t = node.first; t < node.first + node.count; ++t) {
+					glm::vec3 const &a = positions[3*t+0];
+					glm::vec3 e1 = positions[3*t+1] - a;
+					glm::vec3 e2 = positions[3*t+2] - a;
+					glm::vec3 p = glm::cross(direction, e2);
+					float det = glm::dot(e1, p);
+					if (det == 0.0f) continue;
+					float inv_det = 1.0f / det;
+					glm::vec3 s = origin - a;
+					float u = glm::dot(s, p) * inv_det;
+					if (u < 0.0f || u > 1.0f) continue;
+					glm::vec3 q = glm::cross(s, e1);
+					float v = glm::dot(direction, q) * inv_det;
+					if (v < 0.0f || u + v > 1.0f) continue;
+					float d = glm::dot(e2, q) * inv_det;
+					if (d >= 0.0f && d < best_t) {
+						best_t = d;
+						best = t;
+					}
+				}
+				break;
+			}
+
+			//interior: descend into the nearer child, remember the farther one:
+			uint32_t closer = at + 1, farther = node.first;
+			float t_closer = ray_box(origin, inv_direction, best_t, nodes[closer]);
+			float t_farther = ray_box(origin, inv_direction, best_t, nodes[farther]);
+			if (t_farther < t_closer) {
+				std::swap(closer, farther);
+				std::swap(t_closer, t_farther);
+			}
+			if (t_closer == std::numeric_limits< float >::infinity()) break;
+			if (t_farther != std::numeric_limits< float >::infinity()) {
+				stack[top++] = Entry{ farther, t_farther };
+			}
+			at = closer;
+		}
+	}
+
+	if (best == -1U) return false;
+	if (hit) {
+		hit->t = best_t;
+		hit->triangle = triangles[best];
+		hit->normal = glm::cross(positions[3*best+1] - positions[3*best+0], positions[3*best+2] - positions[3*best+0]);
+	}
+	return true;
+}
+
+bool BVH::overlaps_sphere(glm::vec3 const &center, float radius) const {
+	glm::vec3 min = center - glm::vec3(radius);
+	glm::vec3 max = center + glm::vec3(radius);
+	return any_overlap(*this,
+		[&](glm::vec3 const &bmin, glm::vec3 const &bmax) {
+			glm::vec3 d = glm::clamp(center, bmin, bmax) - center;
+			return box_box(min, max, bmin, bmax) && glm::dot(d, d) <= radius * radius;
+		},
+		[&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+			return triangle_sphere(a, b, c, center, radius);
+		}
+	);
+}
+
+bool BVH::overlaps_box(glm::vec3 const &min, glm::vec3 const &max) const {
+	return any_overlap(*this,
+		[&](glm::vec3 const &bmin, glm::vec3 const &bmax) {
+			return box_box(min, max, bmin, bmax);
+		},
+		[&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+			return triangle_box(a, b, c, min, max);
+		}
+	);
+}
+
+bool BVH::ray_cast(Scene::Transform const &transform, glm::vec3 const &origin, glm::vec3 const &direction, float t_max, RayHit *hit) const {
+	//rays transform linearly, so 't' is the same in both spaces:
+	glm::mat4x3 local_from_world = transform.make_local_from_world();
+	glm::vec3 local_origin = local_from_world * glm::vec4(origin, 1.0f);
+	glm::vec3 local_direction = local_from_world * glm::vec4(direction, 0.0f);
+	if (!ray_cast(local_origin, local_direction, t_max, hit)) return false;
+	if (hit) {
+		//normals transform by the inverse transpose:
+		hit->normal = glm::transpose(glm::mat3(local_from_world)) * hit->normal;
+	}
+	return true;
+}
+
+//for world-space shapes: traverse with the (conservative) local-space bounds of the shape,
+// then test each candidate triangle exactly in world space (so non-uniform scale is handled correctly):
+
+bool BVH::overlaps_sphere(Scene::Transform const &transform, glm::vec3 const &center, float radius) const {
+	glm::mat4x3 world_from_local = transform.make_world_from_local();
+	glm::vec3 min, max;
+	transform_box(transform.make_local_from_world(), center, glm::vec3(radius), &min, &max);
+	return any_overlap(*this,
+		[&](glm::vec3 const &bmin, glm::vec3 const &bmax) {
+			return box_box(min, max, bmin, bmax);
+		},
+		[&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+			return triangle_sphere(
+				world_from_local * glm::vec4(a, 1.0f),
+				world_from_local * glm::vec4(b, 1.0f),
+				world_from_local * glm::vec4(c, 1.0f),
+				center, radius);
+		}
+	);
+}
+
+bool BVH::overlaps_box(Scene::Transform const &transform, glm::vec3 const &world_min, glm::vec3 const &world_max) const {
+	glm::mat4x3 world_from_local = transform.make_world_from_local();
+	glm::vec3 min, max;
+	transform_box(transform.make_local_from_world(), 0.5f * (world_min + world_max), 0.5f * (world_max - world_min), &min, &max);
+	return any_overlap(*this,
+		[&](glm::vec3 const &bmin, glm::vec3 const &bmax) {
+			return box_box(min, max, bmin, bmax);
+		},
+		[&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+			return triangle_box(
+				world_from_local * glm::vec4(a, 1.0f),
+				world_from_local * glm::vec4(b, 1.0f),
+				world_from_local * glm::vec4(c, 1.0f),
+				world_min, world_max);
+		}
+	);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * A BVH ("bounding volume hierarchy") organizes a mesh's triangles into a
+ *  tree of boxes so that rays and shapes can be tested against the mesh
+ *  without checking every triangle.
+ *
+ * The tree is built with the surface area heuristic (binned) and stored
+ *  depth-first in one flat array of 32-byte nodes, so traversal walks
+ *  forward through memory most of the time.
+ *
+ * Queries come in two flavors:
+ *  - in the mesh's own (local) space, and
+ *  - in world space, through a Scene::Transform.
+ *
+ * MeshBuffer builds one of these per mesh when asked to (see Mesh.hpp),
+ *  or you can build one directly from triangle positions.
+ *
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct BVH {
+	//build from triangles (every three positions is one triangle):
+	BVH(std::vector< glm::vec3 > const &triangle_positions);
+
+	//result of a ray cast:
+	struct RayHit {
+		float t = std::numeric_limits< float >::infinity(); //hit is at origin + t * direction
+		uint32_t triangle = -1U; //index of triangle hit (in the order passed to the constructor)
+		glm::vec3 normal = glm::vec3(0.0f); //geometric normal of the triangle (in query space, not normalized)
+	};
+
+	//find the closest hit along origin + t * direction, for t in [0, t_max]:
+	// returns true (and fills in 'hit', if supplied) if anything was hit
+	bool ray_cast(glm::vec3 const &origin, glm::vec3 const &direction, float t_max = std::numeric_limits< float >::infinity(), RayHit *hit = nullptr) const;
+
+	//does any triangle touch the given sphere / box?
+	bool overlaps_sphere(glm::vec3 const &center, float radius) const;
+	bool overlaps_box(glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//..the same queries, but with arguments + results in world space for a mesh placed by 'transform':
+	// (n.b. 't' in world space ray hits is still measured in units of 'direction')
+	bool ray_cast(Scene::Transform const &transform, glm::vec3 const &origin, glm::vec3 const &direction, float t_max = std::numeric_limits< float >::infinity(), RayHit *hit = nullptr) const;
+	bool overlaps_sphere(Scene::Transform const &transform, glm::vec3 const &center, float radius) const;
+	bool overlaps_box(Scene::Transform const &transform, glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//-- internals --
+
+	struct Node {
+		glm::vec3 min;
+		uint32_t first; //leaf: first triangle; interior: index of second child (first child is the next node)
+		glm::vec3 max;
+		uint32_t count; //leaf: number of triangles; interior: 0
+	};
+	static_assert(sizeof(Node) == 32, "BVH nodes are packed.");
+
+	std::vector< Node > nodes; //nodes[0] is the root
+	std::vector< glm::vec3 > positions; //triangle corners, reordered so that leaves reference contiguous ranges
+	std::vector< uint32_t > triangles; //original index of each (reordered) triangle
+
+	//leaves hold at most this many triangles:
+	static constexpr uint32_t const MaxLeafTriangles = 4;
+};
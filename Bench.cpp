@@ -0,0 +1,155 @@
+#include "Bench.hpp"
+
+#include "Mode.hpp"
+#include "Textures.hpp"
+#include "GL.hpp"
+#include "FrameArena.hpp"
+#include "Sound.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//local (to this file) helpers for the benchmark:
+namespace {
+	//frames run before timing starts (shader + texture warm-up, first-use allocations):
+	constexpr uint32_t WarmupFrames = 10;
+
+	//scripted input: keys held down for a number of frames, then the next step:
+	// (loops over the steps; covers turning, moving, and raising/lowering the skewer)
+	struct InputStep {
+		uint32_t frames;
+		std::vector< SDL_Keycode > held;
+	};
+	std::vector< InputStep > const Script = {
+		{ 30, { } },
+		{ 60, { SDLK_W } },
+		{ 45, { SDLK_A } },
+		{ 60, { SDLK_W, SDLK_D } },
+		{ 20, { SDLK_R } },
+		{ 60, { SDLK_S, SDLK_A } },
+		{ 20, { SDLK_F } },
+		{ 45, { SDLK_D } },
+	};
+
+	//send key up/down events so that exactly 'held' keys are pressed:
+	void set_held(std::vector< SDL_Keycode > const &previous, std::vector< SDL_Keycode > const &held, glm::uvec2 const &window_size) {
+		auto send = [&](Uint32 type, SDL_Keycode key) {
+			if (!Mode::current) return;
+			SDL_Event evt;
+			SDL_zero(evt);
+			evt.type = type;
+			evt.common.timestamp = SDL_GetTicksNS();
+			evt.key.key = key;
+			evt.key.down = (type == SDL_EVENT_KEY_DOWN);
+			Mode::current->handle_event(evt, window_size);
+		};
+		for (SDL_Keycode key : previous) {
+			if (std::find(held.begin(), held.end(), key) == held.end()) send(SDL_EVENT_KEY_UP, key);
+		}
+		for (SDL_Keycode key : held) {
+			if (std::find(previous.begin(), previous.end(), key) == previous.end()) send(SDL_EVENT_KEY_DOWN, key);
+		}
+	}
+}
+
+void Bench::print_stats(std::string const &name, std::vector< float > times, std::string const &units) {
+	if (times.empty()) return;
+	std::sort(times.begin(), times.end());
+	double total = 0.0;
+	for (float t : times) total += t;
+	auto at = [&](float fraction) {
+		return times[std::min(times.size() - 1, size_t(fraction * float(times.size())))];
+	};
+	std::cout << std::fixed << std::setprecision(3)
+		<< "  " << std::left << std::setw(8) << name << std::right
+		<< "  min " << std::setw(8) << times.front()
+		<< "  median " << std::setw(8) << at(0.5f)
+		<< "  p99 " << std::setw(8) << at(0.99f)
+		<< "  mean " << std::setw(8) << total / times.size()
+		<< "  " << units << std::defaultfloat << std::endl;
+}
+
+void Bench::run(uint32_t frames, glm::uvec2 const &drawable_size) {
+	//fixed step per frame, so simulation is the same no matter how fast frames are:
+	float step = (Mode::tick_rate > 0.0f ? 1.0f / Mode::tick_rate : 1.0f / 60.0f);
+
+	glm::uvec2 window_size = drawable_size; //(hidden window; layout size only used for mouse events)
+	glViewport(0, 0, drawable_size.x, drawable_size.y);
+
+	char const *renderer = reinterpret_cast< char const * >(glGetString(GL_RENDERER));
+	std::cout << "Benchmarking " << frames << " frames at " << drawable_size.x << "x" << drawable_size.y
+		<< " on '" << (renderer ? renderer : "unknown renderer") << "' (" << SDL_GetCurrentVideoDriver() << " video driver)..." << std::endl;
+
+	std::vector< float > update_times, draw_times, frame_times;
+	std::vector< float > allocations; //general-heap allocations per frame (as floats for print_stats)
+	update_times.reserve(frames);
+	draw_times.reserve(frames);
+	frame_times.reserve(frames);
+
+	std::vector< SDL_Keycode > held;
+	size_t script_step = 0;
+	uint32_t script_frames = 0;
+
+	for (uint32_t frame = 0; frame < WarmupFrames + frames && Mode::current; ++frame) {
+		auto frame_start = std::chrono::high_resolution_clock::now();
+		uint64_t allocations_before = FrameArena::heap_allocations();
+		FrameArena::reset();
+		Sound::collect(); //(free sounds that finished playing, as main.cpp does)
+
+		//(1) scripted input:
+		if (script_frames == Script[script_step].frames) {
+			script_frames = 0;
+			script_step = (script_step + 1) % Script.size();
+		}
+		if (script_frames == 0) {
+			set_held(held, Script[script_step].held, window_size);
+			held = Script[script_step].held;
+		}
+		script_frames += 1;
+
+		//(real events are ignored, except for quitting early)
+		SDL_Event evt;
+		while (SDL_PollEvent(&evt)) {
+			if (evt.type == SDL_EVENT_QUIT) Mode::set_current(nullptr);
+		}
+		if (!Mode::current) break;
+
+		//(2) one fixed step + update:
+		auto update_start = std::chrono::high_resolution_clock::now();
+		if (Mode::current) Mode::current->fixed_update(step);
+		Mode::tick_alpha = 1.0f;
+		if (Mode::current) Mode::current->update(step);
+		if (!Mode::current) break;
+		auto update_end = std::chrono::high_resolution_clock::now();
+
+		//(3) draw; glFinish so that time spent in the driver (all of it, on a software renderer) is counted:
+		Textures::update();
+		Mode::current->draw(drawable_size);
+		glFinish();
+		auto draw_end = std::chrono::high_resolution_clock::now();
+
+		SDL_GL_SwapWindow(Mode::window);
+		auto frame_end = std::chrono::high_resolution_clock::now();
+
+		if (frame >= WarmupFrames) {
+			update_times.emplace_back(std::chrono::duration< float, std::milli >(update_end - update_start).count());
+			draw_times.emplace_back(std::chrono::duration< float, std::milli >(draw_end - update_end).count());
+			frame_times.emplace_back(std::chrono::duration< float, std::milli >(frame_end - frame_start).count());
+			allocations.emplace_back(float(FrameArena::heap_allocations() - allocations_before));
+		}
+	}
+
+	set_held(held, { }, window_size);
+
+	std::cout << "Ran " << frame_times.size() << " timed frames:\n";
+	print_stats("update", update_times);
+	print_stats("draw", draw_times);
+	print_stats("total", frame_times);
+	print_stats("allocs", allocations, "(heap allocations)");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+ * Bench runs the current Mode for a fixed number of frames with scripted
+ * input and a fixed timestep, then prints min / median / p99 / mean times
+ * for update, draw, and the whole frame.
+ *
+ * main.cpp uses this for '--bench <frames>', after creating a hidden window
+ * (on SDL's "offscreen" video driver, i.e. an EGL pbuffer, when available)
+ * with vsync off, so it can run on machines without a display.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+//run Mode::current for 'frames' frames (plus a few warm-up frames that aren't timed) and print results:
+// (the OpenGL context must be current; stops early if Mode::current becomes null)
+void run(uint32_t frames, glm::uvec2 const &drawable_size);
+
+//print one line of min / median / p99 / mean for a list of times in milliseconds (or other 'units'):
+// (also used by Replay to report playback frame times)
+void print_stats(std::string const &name, std::vector< float > times, std::string const &units = "(ms)");
+
+} //namespace Bench
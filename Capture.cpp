@@ -0,0 +1,267 @@
+#include "Capture.hpp"
+
+#include "load_save_png.hpp"
+#include "GL.hpp"
+#include "gl_errors.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+uint32_t Capture::max_pending = 8;
+
+//local (to this file) data used by the capture system:
+namespace {
+
+	//a frame on its way to disk:
+	struct Frame {
+		std::string filename; //png file, or raw stream to append to
+		bool raw = false;
+		bool truncate = false; //(raw only) start stream over with this frame?
+		bool fast = false; //(png only) use fast compression?
+		glm::uvec2 size = glm::uvec2(0);
+		std::vector< glm::u8vec4 > pixels;
+	};
+
+	//ring of pixel pack buffers used for asynchronous read-back:
+	struct ReadBack {
+		GLuint buffer = 0;
+		size_t buffer_size = 0;
+		GLsync fence = 0; //non-zero while read is in flight
+		Frame frame; //(metadata only until the read finishes)
+	};
+	constexpr uint32_t const ReadBackCount = 3;
+	std::array< ReadBack, ReadBackCount > read_backs;
+	uint32_t read_head = 0; //next read-back to issue
+	uint32_t read_tail = 0; //oldest read-back in flight
+	uint32_t in_flight = 0;
+
+	//requests (main thread only):
+	std::string pending_screenshot;
+	bool sequence_active = false;
+	Capture::Sequence sequence;
+	uint32_t sequence_frame = 0; //frames seen since sequence start
+	uint32_t sequence_written = 0; //frames captured
+	uint32_t sequence_dropped = 0; //frames skipped because capture fell behind
+	bool sequence_truncate = false; //next raw frame starts the stream
+
+	//encoder thread + queue (guarded by 'mutex'):
+	std::thread encoder;
+	std::mutex mutex;
+	std::condition_variable queue_cv;
+	std::deque< Frame > queue;
+	std::vector< std::vector< glm::u8vec4 > > spare_pixels; //recycled pixel storage
+	bool quit = false;
+
+	void encoder_main() {
+		std::ofstream raw_stream;
+		std::string raw_filename;
+
+		std::unique_lock< std::mutex > lock(mutex);
+		while (true) {
+			queue_cv.wait(lock, [](){ return quit || !queue.empty(); });
+			if (queue.empty()) break; //(only quit once the queue is drained)
+			Frame frame = std::move(queue.front());
+			queue.pop_front();
+			lock.unlock();
+
+			if (frame.raw) {
+				if (frame.truncate || frame.filename != raw_filename) {
+					raw_stream.close();
+					raw_stream.open(frame.filename, std::ios::binary | (frame.truncate ? std::ios::trunc : std::ios::app));
+					raw_filename = frame.filename;
+				}
+				raw_stream.write(reinterpret_cast< char const * >(frame.pixels.data()), frame.pixels.size() * sizeof(glm::u8vec4));
+				if (!raw_stream) {
+					std::cerr << "WARNING: failed writing capture stream '" << frame.filename << "'." << std::endl;
+				}
+			} else {
+				//framebuffer alpha isn't meaningful, so force it opaque:
+				for (auto &px : frame.pixels) {
+					px.a = 0xff;
+				}
+				save_png(frame.filename, frame.size, frame.pixels.data(), LowerLeftOrigin, frame.fast ? FastCompression : DefaultCompression);
+			}
+
+			lock.lock();
+			spare_pixels.emplace_back(std::move(frame.pixels));
+		}
+	}
+
+	//copy a finished read-back out of its buffer and hand it to the encoder:
+	void finish_read_back(ReadBack &rb) {
+		glDeleteSync(rb.fence);
+		rb.fence = 0;
+
+		Frame frame = std::move(rb.frame);
+		rb.frame = Frame();
+
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			if (!spare_pixels.empty()) {
+				frame.pixels = std::move(spare_pixels.back());
+				spare_pixels.pop_back();
+			}
+		}
+		frame.pixels.resize(size_t(frame.size.x) * frame.size.y);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.buffer);
+		size_t bytes = frame.pixels.size() * sizeof(glm::u8vec4);
+		void const *src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+		if (src) {
+			std::memcpy(frame.pixels.data(), src, bytes);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (!src) {
+			std::cerr << "WARNING: failed to map capture buffer; dropping frame for '" << frame.filename << "'." << std::endl;
+			return;
+		}
+
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			queue.emplace_back(std::move(frame));
+		}
+		queue_cv.notify_one();
+	}
+
+	//retire read-backs in order (optionally waiting for all of them):
+	void collect_read_backs(bool wait) {
+		while (in_flight > 0) {
+			ReadBack &rb = read_backs[read_tail];
+			GLenum result = glClientWaitSync(rb.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GLuint64(1000000000) : 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+				if (!wait) break;
+				std::cerr << "WARNING: timed out waiting for capture read-back." << std::endl;
+			}
+			finish_read_back(rb);
+			read_tail = (read_tail + 1) % ReadBackCount;
+			in_flight -= 1;
+		}
+	}
+
+	size_t pending_frames() {
+		std::unique_lock< std::mutex > lock(mutex);
+		return queue.size();
+	}
+}
+
+void Capture::init() {
+	for (auto &rb : read_backs) {
+		glGenBuffers(1, &rb.buffer);
+	}
+	quit = false;
+	encoder = std::thread(encoder_main);
+}
+
+void Capture::shutdown() {
+	if (sequence_active) stop_sequence();
+	collect_read_backs(true);
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	queue_cv.notify_all();
+	if (encoder.joinable()) encoder.join();
+	spare_pixels.clear();
+
+	for (auto &rb : read_backs) {
+		if (rb.buffer) glDeleteBuffers(1, &rb.buffer);
+		rb.buffer = 0;
+		rb.buffer_size = 0;
+	}
+}
+
+void Capture::screenshot(std::string const &filename) {
+	pending_screenshot = filename;
+}
+
+void Capture::start_sequence(Sequence const &sequence_) {
+	sequence = sequence_;
+	if (sequence.every == 0) sequence.every = 1;
+	sequence_active = true;
+	sequence_frame = 0;
+	sequence_written = 0;
+	sequence_dropped = 0;
+	sequence_truncate = true;
+	std::cout << "Capturing every " << sequence.every << " frame(s) to '" << sequence.prefix << (sequence.raw ? ".rgba'" : "-*.png'") << "." << std::endl;
+}
+
+void Capture::stop_sequence() {
+	if (!sequence_active) return;
+	sequence_active = false;
+	std::cout << "Stopped capture: " << sequence_written << " frames captured, " << sequence_dropped << " dropped." << std::endl;
+	if (sequence.raw && sequence_written > 0) {
+		std::cout << "  (raw RGBA, bottom-up rows; e.g. convert with: ffmpeg -f rawvideo -pixel_format rgba -video_size WxH -i " << sequence.prefix << ".rgba -vf vflip " << sequence.prefix << ".mp4)" << std::endl;
+	}
+}
+
+bool Capture::recording() {
+	return sequence_active;
+}
+
+void Capture::frame(glm::uvec2 const &drawable_size) {
+	//hand off any read-backs that have finished:
+	collect_read_backs(false);
+
+	//figure out if this frame should be captured:
+	Frame frame;
+	if (pending_screenshot != "") {
+		frame.filename = pending_screenshot;
+		pending_screenshot = "";
+		std::cout << "Saving screenshot to '" << frame.filename << "'." << std::endl;
+	} else if (sequence_active && (sequence_frame++ % sequence.every) == 0) {
+		frame.raw = sequence.raw;
+		frame.fast = true;
+		if (frame.raw) {
+			frame.filename = sequence.prefix + ".rgba";
+		} else {
+			char number[16];
+			snprintf(number, sizeof(number), "-%06u.png", sequence_written + sequence_dropped);
+			frame.filename = sequence.prefix + number;
+		}
+		//skip this frame rather than slow the main loop if the encoder is behind:
+		if (in_flight == ReadBackCount || pending_frames() >= max_pending) {
+			sequence_dropped += 1;
+			return;
+		}
+		frame.truncate = sequence_truncate;
+		sequence_truncate = false;
+		sequence_written += 1;
+	} else {
+		return;
+	}
+
+	if (in_flight == ReadBackCount) {
+		//(only reachable for screenshots; sequences check above)
+		collect_read_backs(true);
+	}
+
+	//start asynchronous read of the back buffer:
+	ReadBack &rb = read_backs[read_head];
+	frame.size = drawable_size;
+	size_t bytes = size_t(drawable_size.x) * drawable_size.y * sizeof(glm::u8vec4);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.buffer);
+	if (rb.buffer_size != bytes) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+		rb.buffer_size = bytes;
+	}
+	glReadPixels(0, 0, drawable_size.x, drawable_size.y, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	rb.frame = std::move(frame);
+
+	read_head = (read_head + 1) % ReadBackCount;
+	in_flight += 1;
+
+	GL_ERRORS();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Capture saves rendered frames (screenshots or continuous sequences)
+ * without stalling the main loop:
+ *
+ *  - Capture::frame() (called by main.cpp after drawing, before swapping)
+ *    starts an asynchronous glReadPixels of the back buffer into a pixel
+ *    pack buffer and fences it.
+ *  - On later frames, finished read-backs are mapped, copied out, and
+ *    handed to a background thread that does all of the encoding + file I/O.
+ *  - If encoding falls behind, new captures are dropped (and counted)
+ *    rather than slowing the frame rate.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <cstdint>
+
+namespace Capture {
+
+//call from main.cpp after the OpenGL context is created:
+void init();
+
+//call from main.cpp before the OpenGL context is destroyed (finishes writing pending frames):
+void shutdown();
+
+//save the next drawn frame to 'filename' (as a PNG):
+void screenshot(std::string const &filename);
+
+//continuous capture settings:
+struct Sequence {
+	uint32_t every = 1; //capture every Nth frame
+	bool raw = false; //write frames to one raw RGBA stream instead of numbered PNGs
+	std::string prefix = "capture"; //PNGs are written as prefix-000000.png, raw stream as prefix.rgba
+};
+
+//start/stop continuous capture:
+void start_sequence(Sequence const &sequence);
+void stop_sequence();
+bool recording();
+
+//call after each frame is drawn (before swap), with the OpenGL context current:
+void frame(glm::uvec2 const &drawable_size);
+
+//maximum number of frames waiting to be encoded before new captures are dropped:
+extern uint32_t max_pending;
+
+} //namespace Capture
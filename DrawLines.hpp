@@ -9,10 +9,11 @@
  */
 
 
+#include "FrameArena.hpp"
+
 #include <glm/glm.hpp>
 
-#include <string>
-#include <vector>
+#include <string_view>
 
 struct DrawLines {
 	//Start drawing; will remember world_to_clip matrix:
@@ -26,7 +27,7 @@ struct DrawLines {
 
 	//draw wireframe text, start at anchor, move in x direction, mat gives x and y directions for text drawing:
 	// (default character box is 1 unit high)
-	void draw_text(std::string const &text,
+	void draw_text(std::string_view text,
 		glm::vec3 const &anchor,
 		glm::vec3 const &x = glm::vec3(1.0f, 0.0f, 0.0f),
 		glm::vec3 const &y = glm::vec3(0.0f, 1.0f, 1.0f),
@@ -43,6 +44,7 @@ struct DrawLines {
 		glm::vec3 Position;
 		glm::u8vec4 Color;
 	};
-	std::vector< Vertex > attribs;
+	//(from the frame arena, so a DrawLines should only live for part of one frame)
+	FrameArena::vector< Vertex > attribs;
 
 };
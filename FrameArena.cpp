@@ -0,0 +1,147 @@
+#include "FrameArena.hpp"
+#include "RealtimeCheck.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//local (to this file) per-thread arena state:
+namespace {
+	struct Block {
+		char *data = nullptr;
+		size_t size = 0;
+	};
+
+	constexpr size_t InitialBlockSize = 256 * 1024;
+
+	struct Arena {
+		std::vector< Block > blocks; //blocks[0] is the main block; later ones are overflow from this frame
+		size_t at = 0; //bytes used in blocks.back()
+		size_t used = 0; //bytes handed out since reset (including alignment padding)
+		size_t high_water = 0;
+
+		~Arena() {
+			for (auto &block : blocks) std::free(block.data);
+		}
+	};
+
+	thread_local Arena arena;
+	thread_local uint64_t heap_allocation_count = 0;
+
+	Block new_block(size_t size) {
+		heap_allocation_count += 1; //(arena growth counts as a heap allocation)
+		Block block;
+		block.data = static_cast< char * >(std::malloc(size));
+		if (!block.data) throw std::bad_alloc();
+		block.size = size;
+		return block;
+	}
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	if (arena.blocks.empty()) {
+		arena.blocks.emplace_back(new_block(InitialBlockSize));
+		arena.at = 0;
+	}
+
+	Block *block = &arena.blocks.back();
+	size_t start = (reinterpret_cast< uintptr_t >(block->data) + arena.at + alignment - 1) / alignment * alignment - reinterpret_cast< uintptr_t >(block->data);
+	if (start + size > block->size) {
+		//out of room: start an overflow block (replaced by one big block at the next reset):
+		arena.blocks.emplace_back(new_block(std::max(block->size * 2, size + alignment)));
+		block = &arena.blocks.back();
+		arena.at = 0;
+		start = (reinterpret_cast< uintptr_t >(block->data) + alignment - 1) / alignment * alignment - reinterpret_cast< uintptr_t >(block->data);
+	}
+	arena.used += (start - arena.at) + size;
+	arena.high_water = std::max(arena.high_water, arena.used);
+	arena.at = start + size;
+	return block->data + start;
+}
+
+void FrameArena::reset() {
+	if (arena.blocks.size() > 1) {
+		//this frame overflowed; replace everything with one block that would have fit it:
+		size_t total = 0;
+		for (auto &block : arena.blocks) {
+			total += block.size;
+			std::free(block.data);
+		}
+		arena.blocks.clear();
+		arena.blocks.emplace_back(new_block(total));
+	}
+	arena.at = 0;
+	arena.used = 0;
+}
+
+size_t FrameArena::used() {
+	return arena.used;
+}
+
+size_t FrameArena::high_water() {
+	return arena.high_water;
+}
+
+uint64_t FrameArena::heap_allocations() {
+	return heap_allocation_count;
+}
+
+//Replacement global allocation functions, counting allocations per thread:
+// (the array, nothrow, and sized-delete forms all forward to these by default)
+//They also report allocations in real-time code; where RealtimeCheck replaces malloc/free
+// itself, only aligned_alloc (which doesn't go through malloc) needs reporting here.
+
+void *operator new(size_t size) {
+	heap_allocation_count += 1;
+	#ifndef REALTIME_CHECK_LIBC
+	RealtimeCheck::check(RealtimeCheck::Kind::Allocate, "operator new");
+	#endif
+	if (size == 0) size = 1;
+	while (true) {
+		if (void *ptr = std::malloc(size)) return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void *ptr) noexcept {
+	#ifndef REALTIME_CHECK_LIBC
+	if (ptr) RealtimeCheck::check(RealtimeCheck::Kind::Free, "operator delete");
+	#endif
+	std::free(ptr);
+}
+
+void *operator new(size_t size, std::align_val_t alignment_) {
+	heap_allocation_count += 1;
+	RealtimeCheck::check(RealtimeCheck::Kind::Allocate, "aligned operator new");
+	size_t alignment = std::max(size_t(alignment_), sizeof(void *));
+	size = std::max< size_t >(1, (size + alignment - 1) / alignment * alignment);
+	while (true) {
+		#ifdef _WIN32
+		if (void *ptr = _aligned_malloc(size, alignment)) return ptr;
+		#else
+		if (void *ptr = std::aligned_alloc(alignment, size)) return ptr;
+		#endif
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	#ifndef REALTIME_CHECK_LIBC
+	if (ptr) RealtimeCheck::check(RealtimeCheck::Kind::Free, "aligned operator delete");
+	#endif
+	#ifdef _WIN32
+	_aligned_free(ptr);
+	#else
+	std::free(ptr);
+	#endif
+}
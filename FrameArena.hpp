@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * FrameArena is a per-thread bump allocator for memory that only needs to
+ * live until the end of the current frame (e.g., DrawLines vertices):
+ *
+ *  - FrameArena::allocate() just bumps a pointer; there is no per-allocation free.
+ *  - FrameArena::reset() (called by the main loop at the top of each frame,
+ *    and by the render thread before each frame it draws) frees everything
+ *    the calling thread allocated since its last reset.
+ *  - If a frame needs more than the arena holds, extra blocks come from the
+ *    heap, and the next reset replaces them with one block big enough for
+ *    the whole frame -- so a steady-state frame never touches the heap.
+ *
+ * FrameArena::Allocator< T > lets standard containers use the arena
+ * (see FrameArena::vector); such containers must not outlive the frame.
+ *
+ * This file also counts general-heap allocations (by replacing global
+ * operator new) per thread, so main.cpp can report allocations per frame.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FrameArena {
+
+//get 'size' bytes aligned to 'alignment' (a power of two) that stay valid until this thread's next reset():
+void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+//release everything this thread allocated from the arena:
+void reset();
+
+//bytes currently allocated from this thread's arena / most ever allocated between resets:
+size_t used();
+size_t high_water();
+
+//number of general-heap allocations (operator new) made by this thread so far:
+uint64_t heap_allocations();
+
+//STL-compatible allocator that takes memory from the arena of whichever thread allocates:
+template< typename T >
+struct Allocator {
+	using value_type = T;
+	Allocator() = default;
+	template< typename U >
+	Allocator(Allocator< U > const &) { }
+	T *allocate(size_t n) {
+		return static_cast< T * >(FrameArena::allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t) { } //(freed all at once by reset)
+	template< typename U >
+	bool operator==(Allocator< U > const &) const { return true; }
+	template< typename U >
+	bool operator!=(Allocator< U > const &) const { return false; }
+};
+
+template< typename T >
+using vector = std::vector< T, Allocator< T > >;
+
+} //namespace FrameArena
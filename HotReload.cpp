@@ -0,0 +1,175 @@
+#include "HotReload.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+//local (to this file) data used by the hot reloading system:
+namespace {
+
+	struct Watch {
+		void const *owner;
+		std::function< void() > on_change;
+	};
+
+	struct WatchedFile {
+		std::vector< Watch > watches;
+		std::filesystem::file_time_type time; //(used by polling fallback)
+	};
+
+	bool is_enabled = false;
+	std::map< std::string, WatchedFile > files; //by normalized absolute path
+	std::set< std::string > pending_changes; //changed files gathered but not yet reloaded
+
+	std::string normalize(std::string const &filename) {
+		std::error_code ec;
+		std::filesystem::path path = std::filesystem::absolute(filename, ec);
+		if (ec) path = filename;
+		return path.lexically_normal().string();
+	}
+
+	#if defined(__linux__)
+	int inotify_fd = -1;
+	std::map< int, std::string > watched_dirs; //inotify watch descriptor -> directory path
+
+	void watch_directory(std::string const &dir) {
+		for (auto const &[wd, path] : watched_dirs) {
+			if (path == dir) return;
+		}
+		int wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0) {
+			std::cerr << "WARNING: failed to watch directory '" << dir << "' for changes." << std::endl;
+			return;
+		}
+		watched_dirs.emplace(wd, dir);
+	}
+
+	void gather_changes(std::set< std::string > *changed) {
+		alignas(inotify_event) char buffer[4096];
+		while (true) {
+			ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+			if (len <= 0) break; //(EAGAIN: no more events right now)
+			for (char *at = buffer; at < buffer + len; ) {
+				inotify_event const *event = reinterpret_cast< inotify_event const * >(at);
+				at += sizeof(inotify_event) + event->len;
+				auto dir = watched_dirs.find(event->wd);
+				if (dir == watched_dirs.end() || event->len == 0) continue;
+				std::string path = (std::filesystem::path(dir->second) / event->name).lexically_normal().string();
+				if (files.count(path)) changed->insert(path);
+			}
+		}
+	}
+	#else
+	void gather_changes(std::set< std::string > *changed) {
+		//poll modification times (at most a few times per second):
+		static auto last_poll = std::chrono::steady_clock::now();
+		auto now = std::chrono::steady_clock::now();
+		if (now - last_poll < std::chrono::milliseconds(250)) return;
+		last_poll = now;
+
+		for (auto &[path, file] : files) {
+			std::error_code ec;
+			auto time = std::filesystem::last_write_time(path, ec);
+			if (ec) continue;
+			if (time != file.time) {
+				file.time = time;
+				changed->insert(path);
+			}
+		}
+	}
+	#endif
+}
+
+void HotReload::init() {
+	if (is_enabled) return;
+	#if defined(__linux__)
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0) {
+		std::cerr << "WARNING: inotify unavailable; hot reloading disabled." << std::endl;
+		return;
+	}
+	#endif
+	is_enabled = true;
+	std::cout << "Hot reloading enabled." << std::endl;
+}
+
+void HotReload::shutdown() {
+	#if defined(__linux__)
+	if (inotify_fd >= 0) close(inotify_fd);
+	inotify_fd = -1;
+	watched_dirs.clear();
+	#endif
+	files.clear();
+	pending_changes.clear();
+	is_enabled = false;
+}
+
+bool HotReload::enabled() {
+	return is_enabled;
+}
+
+void HotReload::watch(std::string const &filename, void const *owner, std::function< void() > const &on_change) {
+	if (!is_enabled) return;
+	std::string path = normalize(filename);
+	auto ret = files.emplace(path, WatchedFile());
+	if (ret.second) {
+		std::error_code ec;
+		ret.first->second.time = std::filesystem::last_write_time(path, ec);
+		#if defined(__linux__)
+		watch_directory(std::filesystem::path(path).parent_path().string());
+		#endif
+	}
+	ret.first->second.watches.emplace_back(Watch{ owner, on_change });
+}
+
+void HotReload::unwatch(void const *owner) {
+	if (!is_enabled) return;
+	for (auto &[path, file] : files) {
+		for (auto w = file.watches.begin(); w != file.watches.end(); /* later */) {
+			if (w->owner == owner) w = file.watches.erase(w);
+			else ++w;
+		}
+	}
+}
+
+bool HotReload::pending() {
+	if (!is_enabled) return false;
+	gather_changes(&pending_changes);
+	return !pending_changes.empty();
+}
+
+void HotReload::update() {
+	if (!is_enabled) return;
+
+	std::set< std::string > changed;
+	gather_changes(&pending_changes);
+	std::swap(changed, pending_changes);
+
+	for (auto const &path : changed) {
+		auto f = files.find(path);
+		if (f == files.end()) continue;
+		//copy callbacks, since reloading may watch/unwatch:
+		std::vector< Watch > watches = f->second.watches;
+
+		auto before = std::chrono::high_resolution_clock::now();
+		try {
+			for (auto const &w : watches) {
+				w.on_change();
+			}
+		} catch (std::exception &e) {
+			std::cerr << "WARNING: failed to reload '" << path << "' (keeping old data): " << e.what() << std::endl;
+			continue;
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+		std::cout << "Reloaded '" << path << "' in " << std::chrono::duration< float, std::milli >(after - before).count() << " ms." << std::endl;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * HotReload watches asset files and calls back when they change on disk,
+ * so that loaders can patch already-loaded data in place instead of
+ * requiring a restart.
+ *
+ * On Linux this uses inotify (watching the directories that contain the
+ * files, so editors that save by writing a new file + renaming still work);
+ * elsewhere it falls back to polling modification times.
+ *
+ * Loaders (MeshBuffer, Scene::load, Sound::Sample) register themselves
+ * when HotReload::enabled(), so call HotReload::init() *before*
+ * call_load_functions().
+ *
+ */
+
+#include <functional>
+#include <string>
+
+namespace HotReload {
+
+//start watching (call from main.cpp before loading assets):
+void init();
+
+//stop watching + drop all callbacks:
+void shutdown();
+
+//has init() been called?
+bool enabled();
+
+//call 'on_change' (from update()) whenever 'filename' changes:
+// 'owner' identifies the watch so it can be removed with unwatch().
+// (does nothing if hot reloading isn't enabled)
+void watch(std::string const &filename, void const *owner, std::function< void() > const &on_change);
+
+//remove all watches registered with 'owner':
+void unwatch(void const *owner);
+
+//have any watched files changed since the last update()?
+// (lets a caller with the OpenGL context on another thread know when to pause and call update())
+bool pending();
+
+//run callbacks for any files that changed since the last call:
+// (call once per frame from the main loop, with the OpenGL context current)
+void update();
+
+} //namespace HotReload
@@ -0,0 +1,291 @@
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+struct Jobs::Task {
+	std::function< void() > fn;
+	bool main_thread = false;
+	std::atomic< uint32_t > waiting{1}; //unfinished prerequisites (+1 until submission is complete)
+
+	std::mutex mutex; //guards 'dependents' and the transition to 'finished'
+	std::vector< Handle > dependents; //tasks waiting for this one
+	std::atomic< bool > finished{false};
+	std::exception_ptr exception; //set if 'fn' threw (read after 'finished')
+};
+
+//local (to this file) scheduler state:
+namespace {
+	struct Queue {
+		std::mutex mutex;
+		std::deque< Jobs::Handle > tasks;
+	};
+
+	//one queue per worker, plus a shared queue (at the end) for tasks submitted from other threads:
+	std::vector< std::unique_ptr< Queue > > queues;
+	std::vector< std::thread > threads;
+
+	//index into 'queues' of the current thread's own queue (-1 if not a worker):
+	thread_local int32_t worker_index = -1;
+
+	//main-thread tasks:
+	std::mutex main_mutex;
+	std::deque< Jobs::Handle > main_tasks;
+	std::atomic< std::thread::id > main_id(std::this_thread::get_id()); //(atomic: Jobs::set_main_thread may be called while other threads wait)
+
+	//sleeping workers wait for 'queued' to be nonzero:
+	std::atomic< uint32_t > queued{0};
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_cv;
+	bool quit = false; //guarded by sleep_mutex
+
+	Queue &shared_queue() {
+		if (queues.empty()) queues.emplace_back(std::make_unique< Queue >()); //(no workers started)
+		return *queues.back();
+	}
+
+	void enqueue(Jobs::Handle const &task) {
+		if (task->main_thread) {
+			std::lock_guard< std::mutex > lock(main_mutex);
+			main_tasks.emplace_back(task);
+			return;
+		}
+		Queue &queue = (worker_index >= 0 ? *queues[worker_index] : shared_queue());
+		{
+			std::lock_guard< std::mutex > lock(queue.mutex);
+			queue.tasks.emplace_back(task);
+		}
+		queued.fetch_add(1);
+		//(take + release the sleep lock so a worker can't miss this between checking 'queued' and sleeping)
+		{ std::lock_guard< std::mutex > lock(sleep_mutex); }
+		sleep_cv.notify_one();
+	}
+
+	//get a ready (non-main-thread) task: own queue first, then steal:
+	bool take(Jobs::Handle *task) {
+		if (queued.load() == 0) return false;
+		if (queues.empty()) return false;
+		size_t count = queues.size();
+		size_t own = (worker_index >= 0 ? size_t(worker_index) : count - 1);
+
+		if (worker_index >= 0) {
+			Queue &queue = *queues[own];
+			std::lock_guard< std::mutex > lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				*task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+		for (size_t i = (worker_index >= 0 ? 1 : 0); i < count; ++i) {
+			Queue &queue = *queues[(own + i) % count];
+			std::lock_guard< std::mutex > lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				*task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool take_main(Jobs::Handle *task) {
+		std::lock_guard< std::mutex > lock(main_mutex);
+		if (main_tasks.empty()) return false;
+		*task = std::move(main_tasks.front());
+		main_tasks.pop_front();
+		return true;
+	}
+
+	void execute(Jobs::Handle const &task) {
+		try {
+			task->fn();
+		} catch (...) {
+			task->exception = std::current_exception();
+		}
+		task->fn = nullptr; //(release anything the function captured)
+
+		std::vector< Jobs::Handle > dependents;
+		{
+			std::lock_guard< std::mutex > lock(task->mutex);
+			task->finished = true;
+			std::swap(dependents, task->dependents);
+		}
+		for (auto const &dependent : dependents) {
+			if (dependent->waiting.fetch_sub(1) == 1) enqueue(dependent);
+		}
+	}
+
+	void worker_main(int32_t index) {
+		worker_index = index;
+		while (true) {
+			Jobs::Handle task;
+			if (take(&task)) {
+				execute(task);
+				continue;
+			}
+			std::unique_lock< std::mutex > lock(sleep_mutex);
+			sleep_cv.wait(lock, [](){ return quit || queued.load() > 0; });
+			if (quit && queued.load() == 0) break;
+		}
+	}
+
+	Jobs::Handle submit(std::function< void() > const &fn, std::vector< Jobs::Handle > const &after, bool main_thread) {
+		Jobs::Handle task = std::make_shared< Jobs::Task >();
+		task->fn = fn;
+		task->main_thread = main_thread;
+		for (auto const &before : after) {
+			if (!before) continue;
+			std::lock_guard< std::mutex > lock(before->mutex);
+			if (!before->finished) {
+				task->waiting.fetch_add(1);
+				before->dependents.emplace_back(task);
+			}
+		}
+		if (task->waiting.fetch_sub(1) == 1) enqueue(task);
+		return task;
+	}
+}
+
+void Jobs::init(uint32_t workers) {
+	assert(threads.empty() && "Jobs::init should only be called once (or after shutdown)");
+	if (workers == 0) {
+		workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+	main_id = std::this_thread::get_id();
+
+	//(keep anything already submitted to the shared queue)
+	std::unique_ptr< Queue > shared = (queues.empty() ? std::make_unique< Queue >() : std::move(queues.back()));
+	queues.clear();
+	for (uint32_t i = 0; i < workers; ++i) {
+		queues.emplace_back(std::make_unique< Queue >());
+	}
+	queues.emplace_back(std::move(shared));
+
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		quit = false;
+	}
+	for (uint32_t i = 0; i < workers; ++i) {
+		threads.emplace_back(worker_main, int32_t(i));
+	}
+}
+
+void Jobs::shutdown() {
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		quit = true;
+	}
+	sleep_cv.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+	queues.clear();
+	queued = 0;
+
+	std::lock_guard< std::mutex > lock(main_mutex);
+	if (!main_tasks.empty()) {
+		std::cerr << "WARNING: dropping " << main_tasks.size() << " main-thread job(s) at shutdown." << std::endl;
+		main_tasks.clear();
+	}
+}
+
+uint32_t Jobs::worker_count() {
+	return uint32_t(threads.size());
+}
+
+Jobs::Handle Jobs::run(std::function< void() > const &fn, std::vector< Handle > const &after) {
+	return submit(fn, after, false);
+}
+
+Jobs::Handle Jobs::run_on_main(std::function< void() > const &fn, std::vector< Handle > const &after) {
+	return submit(fn, after, true);
+}
+
+bool Jobs::done(Handle const &task) {
+	return !task || task->finished.load();
+}
+
+void Jobs::wait(Handle const &task) {
+	if (!task) return;
+	bool is_main = (std::this_thread::get_id() == main_id.load());
+	while (!task->finished.load()) {
+		Handle other;
+		if (is_main && take_main(&other)) execute(other);
+		else if (take(&other)) execute(other);
+		else std::this_thread::yield();
+	}
+	if (task->exception) std::rethrow_exception(task->exception);
+}
+
+void Jobs::parallel_for(size_t count, size_t grain, std::function< void(size_t begin, size_t end) > const &fn) {
+	if (count == 0) return;
+	grain = std::max< size_t >(1, grain);
+	size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || worker_count() == 0) {
+		fn(0, count);
+		return;
+	}
+
+	//helpers (and this thread) grab chunks in order until none are left:
+	std::atomic< size_t > next_chunk{0};
+	auto work = [&]() {
+		while (true) {
+			size_t chunk = next_chunk.fetch_add(1);
+			if (chunk >= chunks) break;
+			fn(chunk * grain, std::min(count, (chunk + 1) * grain));
+		}
+	};
+
+	std::vector< Handle > helpers;
+	helpers.reserve(std::min< size_t >(worker_count(), chunks - 1));
+	for (size_t i = 0; i < std::min< size_t >(worker_count(), chunks - 1); ++i) {
+		helpers.emplace_back(run(work));
+	}
+
+	//(helpers reference this stack frame, so wait for all of them even if something threw)
+	std::exception_ptr exception;
+	try {
+		work();
+	} catch (...) {
+		exception = std::current_exception();
+		next_chunk = chunks;
+	}
+	for (auto const &helper : helpers) {
+		try {
+			wait(helper);
+		} catch (...) {
+			if (!exception) exception = std::current_exception();
+		}
+	}
+	if (exception) std::rethrow_exception(exception);
+}
+
+void Jobs::set_main_thread() {
+	main_id = std::this_thread::get_id();
+}
+
+void Jobs::update() {
+	assert(std::this_thread::get_id() == main_id.load() && "Jobs::update should be called from the main thread");
+	//(only run tasks that were ready at the start, so tasks that queue more main-thread work can't starve the frame)
+	size_t count;
+	{
+		std::lock_guard< std::mutex > lock(main_mutex);
+		count = main_tasks.size();
+	}
+	for (size_t i = 0; i < count; ++i) {
+		Handle task;
+		if (!take_main(&task)) break;
+		execute(task);
+	}
+}
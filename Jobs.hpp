@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+ * Jobs is a small work-stealing task scheduler shared by engine code
+ * (loaders, Scene, Mesh, Sound, ...):
+ *
+ *  - Each worker thread has its own deque of ready tasks; it pushes + pops
+ *    its own tasks at the back (most recent first, for cache locality) and,
+ *    when out of work, steals from the front of other workers' deques.
+ *  - Tasks submitted from other threads go into a shared deque that
+ *    everyone steals from.
+ *  - A task can list other tasks that must finish before it starts.
+ *  - Tasks submitted with run_on_main() only ever run on the "main" thread
+ *    (the one that owns the OpenGL context), from Jobs::update() or while
+ *    that thread is in Jobs::wait().
+ *  - Threads that wait() help by running other ready tasks, so waiting
+ *    from inside a task is fine, and everything still works (on the
+ *    waiting thread) with zero workers.
+ *
+ * Don't wait on tasks from the audio callback.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Jobs {
+
+struct Task; //(internal)
+using Handle = std::shared_ptr< Task >;
+
+//start worker threads (call from main.cpp before loading assets):
+// 'workers' == 0 picks one less than the number of hardware threads
+// (the calling thread becomes the main thread)
+void init(uint32_t workers = 0);
+
+//finish any queued (non-main-thread) tasks and stop worker threads:
+void shutdown();
+
+//number of worker threads (0 if not started):
+uint32_t worker_count();
+
+//queue 'fn' to run on some worker once all tasks in 'after' have finished:
+Handle run(std::function< void() > const &fn, std::vector< Handle > const &after = {});
+
+//queue 'fn' to run on the main thread (e.g., for OpenGL calls) once all tasks in 'after' have finished:
+Handle run_on_main(std::function< void() > const &fn, std::vector< Handle > const &after = {});
+
+//has 'task' finished?
+bool done(Handle const &task);
+
+//run other tasks until 'task' has finished:
+// (if the task threw an exception, it is re-thrown here)
+void wait(Handle const &task);
+
+//call fn(begin, end) over chunks of at most 'grain' items covering [0, count), in parallel:
+// (the calling thread works too; returns once every chunk is done)
+void parallel_for(size_t count, size_t grain, std::function< void(size_t begin, size_t end) > const &fn);
+
+//make the calling thread the main thread (e.g., when the OpenGL context moves to a render thread):
+void set_main_thread();
+
+//run any ready main-thread tasks (call from the main thread once per frame):
+void update();
+
+} //namespace Jobs
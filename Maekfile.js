@@ -63,7 +63,7 @@ if (maek.OS === "windows") {
 	);
 	maek.options.LINKLibs.push(
 		//linker flags for nest libraries:
-		`-L${NEST_LIBS}/SDL3/lib`, `-lSDL3`, `-lm`, `-lpthread`, `-lGL`,
+		`-L${NEST_LIBS}/SDL3/lib`, `-lSDL3`, `-lm`, `-lpthread`, `-ldl`, `-lGL`, //(-ldl for RealtimeCheck's lock hooks)
 		`-L${NEST_LIBS}/libpng/lib`, `-lpng`,
 		`-L${NEST_LIBS}/zlib/lib`, `-lz`,
 		`-L${NEST_LIBS}/opusfile/lib`, `-lopusfile`,
@@ -135,14 +135,25 @@ if (maek.OS === 'windows') {
 // cppFile: name of c++ file to compile
 // objFileBase (optional): base name object file to produce (if not supplied, set to options.objDir + '/' + cppFile without the extension)
 //returns objFile: objFileBase + a platform-dependant suffix ('.o' or '.obj')
+
+//sound system (shared by the game and the audio benchmark):
+const sound_names = [
+	maek.CPP('Sound.cpp'),
+	maek.CPP('SoundEffects.cpp'),
+	maek.CPP('load_wav.cpp'),
+	maek.CPP('load_opus.cpp')
+];
+
 const game_names = [
 	maek.CPP('PlayMode.cpp'),
 	maek.CPP('main.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp'),
 	//maek.CPP('ColorTextureProgram.cpp'),  //not used right now, but you might want it
-	maek.CPP('Sound.cpp'),
-	maek.CPP('load_wav.cpp'),
-	maek.CPP('load_opus.cpp')
+	...sound_names,
+	maek.CPP('Textures.cpp'),
+	maek.CPP('Capture.cpp'),
+	maek.CPP('Bench.cpp'),
+	maek.CPP('Replay.cpp')
 ];
 
 const common_names = [
@@ -157,7 +168,14 @@ const common_names = [
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
-	maek.CPP('Load.cpp')
+	maek.CPP('Load.cpp'),
+	maek.CPP('Snapshot.cpp'),
+	maek.CPP('MappedFile.cpp'),
+	maek.CPP('Jobs.cpp'),
+	maek.CPP('FrameArena.cpp'),
+	maek.CPP('RealtimeCheck.cpp'),
+	maek.CPP('HotReload.cpp'),
+	maek.CPP('BVH.cpp')
 ];
 
 const show_meshes_names = [
@@ -166,6 +184,23 @@ const show_meshes_names = [
 	maek.CPP('ShowMeshesMode.cpp')
 ];
 
+const bench_bvh_names = [
+	maek.CPP('bench-bvh.cpp')
+];
+
+const bench_spatial_names = [
+	maek.CPP('bench-spatial.cpp')
+];
+
+const bench_jobs_names = [
+	maek.CPP('bench-jobs.cpp')
+];
+
+const bench_audio_names = [
+	maek.CPP('bench-audio.cpp'),
+	...sound_names
+];
+
 const show_scene_names = [
 	maek.CPP('show-scene.cpp'),
 	maek.CPP('ShowSceneProgram.cpp'),
@@ -179,9 +214,13 @@ const show_scene_names = [
 const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+const bench_bvh_exe = maek.LINK([...bench_bvh_names, ...common_names], 'dist/bench-bvh');
+const bench_spatial_exe = maek.LINK([...bench_spatial_names, ...common_names], 'dist/bench-spatial');
+const bench_jobs_exe = maek.LINK([...bench_jobs_names, ...common_names], 'dist/bench-jobs');
+const bench_audio_exe = maek.LINK([...bench_audio_names, ...common_names], 'dist/bench-audio');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, bench_bvh_exe, bench_spatial_exe, bench_jobs_exe, bench_audio_exe, ...copies];
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
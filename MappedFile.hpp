@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+ * MappedFile maps an entire file into (read-only) memory.
+ *
+ * Useful for large, pre-baked binary blobs that should be used in-place
+ * instead of being read and copied.
+ *
+ */
+
+#include <string>
+#include <cstddef>
+
+struct MappedFile {
+	//map the given file:
+	// note: will throw if the file can't be opened or mapped.
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	//the mapping is a unique resource, so copying is not allowed:
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	//mapped contents of the file:
+	char const *data = nullptr;
+	size_t size = 0;
+
+	//-- internals --
+	#if defined(_WIN32)
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+};
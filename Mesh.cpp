@@ -1,5 +1,10 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "Snapshot.hpp"
+#include "HotReload.hpp"
+#include "Scene.hpp"
+#include "BVH.hpp"
+#include "Jobs.hpp"
 
 #include <glm/glm.hpp>
 
@@ -10,43 +15,55 @@
 #include <string>
 #include <set>
 #include <cstddef>
+#include <algorithm>
+#include <iterator>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+namespace {
 
-	std::ifstream file(filename, std::ios::binary);
+//vertex format of '.pnct' files:
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
 
-	GLuint total = 0;
+//layout of a MeshBuffer's state in a startup snapshot:
+struct SnapshotMesh {
+	uint32_t name_begin, name_end;
+	GLenum type;
+	GLuint start, count;
+	glm::vec3 min, max;
+};
+static_assert(sizeof(SnapshotMesh) == 4*5 + 4*3*2, "SnapshotMesh is packed.");
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
+struct SnapshotHeader {
+	Snapshot::Range< Vertex > vertices;
+	Snapshot::Range< char > names;
+	Snapshot::Range< SnapshotMesh > meshes;
+};
 
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+}
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+//read vertices + mesh table from a '.pnct' file:
+static void read_pnct(std::string const &filename, std::vector< Vertex > *data_, std::map< std::string, Mesh > *meshes_) {
+	assert(data_);
+	assert(meshes_);
+	auto &data = *data_;
+	auto &meshes = *meshes_;
 
-		total = GLuint(data.size()); //store total for later checks on index
+	std::ifstream file(filename, std::ios::binary);
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	//read data chunk:
+	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
+		read_chunk(file, "pnct", &data);
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
+	GLuint total = GLuint(data.size()); //store total for later checks on index
+
 	std::vector< char > strings;
 	read_chunk(file, "str0", &strings);
 
@@ -86,6 +103,115 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	if (file.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
+}
+
+//build a BVH for each triangle mesh:
+static void build_mesh_bvhs(Vertex const *vertices, std::map< std::string, Mesh > *meshes) {
+	std::vector< Mesh * > todo;
+	for (auto &[name, mesh] : *meshes) {
+		if (mesh.type == GL_TRIANGLES) todo.emplace_back(&mesh);
+	}
+	//(meshes are independent, so build their BVHs on worker threads)
+	Jobs::parallel_for(todo.size(), 1, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; ++i) {
+			Mesh &mesh = *todo[i];
+			std::vector< glm::vec3 > positions;
+			positions.reserve(mesh.count);
+			for (GLuint v = mesh.start; v < mesh.start + mesh.count; ++v) {
+				positions.emplace_back(vertices[v].Position);
+			}
+			positions.resize(positions.size() / 3 * 3); //(drop any partial triangle)
+			mesh.bvh = std::make_shared< BVH const >(positions);
+		}
+	});
+}
+
+MeshBuffer::MeshBuffer(std::string const &filename, bool build_bvhs_) : build_bvhs(build_bvhs_) {
+	glGenBuffers(1, &buffer);
+
+	//vertex data to upload:
+	char const *vertices = nullptr;
+	size_t vertices_size = 0;
+
+	std::vector< Vertex > data;
+	std::string_view blob;
+	if (Snapshot::find(filename, &blob)) {
+		//build the mesh table directly from the snapshot:
+		SnapshotHeader const &header = Snapshot::header< SnapshotHeader >(blob);
+		char const *names = Snapshot::get(blob, header.names);
+		SnapshotMesh const *entries = Snapshot::get(blob, header.meshes);
+		for (uint64_t i = 0; i < header.meshes.count; ++i) {
+			SnapshotMesh const &entry = entries[i];
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= header.names.count)) {
+				throw std::runtime_error("snapshot of '" + filename + "' has out-of-range mesh name");
+			}
+			Mesh mesh;
+			mesh.type = entry.type;
+			mesh.start = entry.start;
+			mesh.count = entry.count;
+			mesh.min = entry.min;
+			mesh.max = entry.max;
+			meshes.emplace(std::string(names + entry.name_begin, names + entry.name_end), mesh);
+		}
+
+		//...and upload straight from the snapshot:
+		vertices = reinterpret_cast< char const * >(Snapshot::get(blob, header.vertices));
+		vertices_size = header.vertices.count * sizeof(Vertex);
+	} else {
+		read_pnct(filename, &data, &meshes);
+
+		vertices = reinterpret_cast< char const * >(data.data());
+		vertices_size = data.size() * sizeof(Vertex);
+
+		if (Snapshot::active()) { //record built state for later runs:
+			std::vector< char > names;
+			std::vector< SnapshotMesh > entries;
+			entries.reserve(meshes.size());
+			for (auto const &[name, mesh] : meshes) {
+				SnapshotMesh entry;
+				entry.name_begin = uint32_t(names.size());
+				names.insert(names.end(), name.begin(), name.end());
+				entry.name_end = uint32_t(names.size());
+				entry.type = mesh.type;
+				entry.start = mesh.start;
+				entry.count = mesh.count;
+				entry.min = mesh.min;
+				entry.max = mesh.max;
+				entries.emplace_back(entry);
+			}
+			Snapshot::Writer writer;
+			writer.reserve_header< SnapshotHeader >();
+			SnapshotHeader header;
+			header.vertices = writer.append(data);
+			header.names = writer.append(names);
+			header.meshes = writer.append(entries);
+			writer.set_header(header);
+			Snapshot::store(filename, std::move(writer.blob));
+		}
+	}
+
+	//upload data:
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (build_bvhs) {
+		build_mesh_bvhs(reinterpret_cast< Vertex const * >(vertices), &meshes);
+	}
+
+	//store attrib locations:
+	Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+	Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+	Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+	TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+
+	if (HotReload::enabled()) {
+		//keep a copy of the uploaded data so reloads can find the range that changed:
+		reload_vertices.assign(vertices, vertices + vertices_size);
+		HotReload::watch(filename, this, [this,filename](){
+			reload(filename);
+		});
+	}
 
 	/* //DEBUG:
 	std::cout << "File '" << filename << "' contained meshes";
@@ -98,6 +224,85 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
+MeshBuffer::~MeshBuffer() {
+	HotReload::unwatch(this);
+}
+
+void MeshBuffer::reload(std::string const &filename) {
+	std::vector< Vertex > data;
+	std::map< std::string, Mesh > new_meshes;
+	read_pnct(filename, &data, &new_meshes);
+	if (build_bvhs) {
+		build_mesh_bvhs(data.data(), &new_meshes);
+	}
+
+	char const *vertices = reinterpret_cast< char const * >(data.data());
+	size_t vertices_size = data.size() * sizeof(Vertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (vertices_size == reload_vertices.size()) {
+		//same size: re-upload only the byte range that differs
+		auto first = std::mismatch(vertices, vertices + vertices_size, reload_vertices.begin()).first - vertices;
+		if (first < GLsizeiptr(vertices_size)) {
+			auto last = vertices_size - (std::mismatch(
+				std::make_reverse_iterator(vertices + vertices_size), std::make_reverse_iterator(vertices + first),
+				reload_vertices.rbegin()).first - std::make_reverse_iterator(vertices + vertices_size));
+			glBufferSubData(GL_ARRAY_BUFFER, first, last - first, vertices + first);
+			std::cout << "  re-uploaded bytes [" << first << ", " << last << ") of " << vertices_size << "." << std::endl;
+		}
+	} else {
+		//size changed: re-specify the whole buffer (same buffer name, so existing vaos stay valid)
+		glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+		std::cout << "  re-uploaded all " << vertices_size << " bytes." << std::endl;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	reload_vertices.assign(vertices, vertices + vertices_size);
+
+	//figure out which old vertex ranges moved:
+	struct Moved {
+		Mesh const *from;
+		Mesh const *to;
+	};
+	std::vector< Moved > moved;
+	for (auto const &[name, mesh] : meshes) {
+		auto f = new_meshes.find(name);
+		if (f == new_meshes.end()) {
+			std::cerr << "WARNING: mesh '" << name << "' was removed from '" << filename << "'; drawables using it will keep the old vertex range." << std::endl;
+			continue;
+		}
+		Mesh const &to = f->second;
+		if (mesh.type != to.type || mesh.start != to.start || mesh.count != to.count) {
+			moved.emplace_back(Moved{ &mesh, &to });
+		}
+	}
+
+	//patch drawables in live scenes that use moved ranges from this buffer:
+	if (!moved.empty()) {
+		uint32_t patched = 0;
+		Scene::for_each_live_scene([&](Scene &scene) {
+			for (auto &drawable : scene.drawables) {
+				Scene::Drawable::Pipeline &pipeline = drawable.pipeline;
+				if (std::find(vaos.begin(), vaos.end(), pipeline.vao) == vaos.end()) continue;
+				for (auto const &m : moved) {
+					if (pipeline.type == m.from->type && pipeline.start == m.from->start && pipeline.count == m.from->count) {
+						pipeline.type = m.to->type;
+						pipeline.start = m.to->start;
+						pipeline.count = m.to->count;
+						patched += 1;
+						break;
+					}
+				}
+			}
+		});
+		std::cout << "  patched " << patched << " drawables." << std::endl;
+	}
+
+	//update mesh table in place (so existing Mesh references stay valid):
+	for (auto const &[name, mesh] : new_meshes) {
+		meshes[name] = mesh;
+	}
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
@@ -130,6 +335,8 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
+	vaos.emplace_back(vao);
+
 	//Check that all active attributes were bound:
 	GLint active = 0;
 	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &active);
@@ -13,7 +13,11 @@
 #include <glm/glm.hpp>
 #include <map>
 #include <limits>
+#include <memory>
 #include <string>
+#include <vector>
+
+struct BVH;
 
 
 struct Mesh {
@@ -24,15 +28,21 @@ struct Mesh {
 	GLuint count = 0; //count of vertices
 
 	//Bounding box.
-	//useful for debug visualization and (perhaps, eventually) collision detection:
+	//useful for debug visualization and coarse collision checks:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//Triangle hierarchy for ray casts and overlap tests (see BVH.hpp):
+	// only built if the MeshBuffer was constructed with build_bvhs = true (and only for GL_TRIANGLES meshes)
+	std::shared_ptr< BVH const > bvh;
 };
 
 struct MeshBuffer {
 	//construct from a file:
 	// note: will throw if file fails to read.
-	MeshBuffer(std::string const &filename);
+	// if build_bvhs is set, keeps a CPU-side BVH per mesh for geometric queries (costs build time + memory)
+	MeshBuffer(std::string const &filename, bool build_bvhs = false);
+	~MeshBuffer();
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
@@ -67,4 +77,18 @@ struct MeshBuffer {
 	Attrib Normal;
 	Attrib Color;
 	Attrib TexCoord;
+
+	//were BVHs requested at construction?
+	bool build_bvhs = false;
+
+	//vertex array objects built by make_vao_for_program (used to find drawables to patch on reload):
+	mutable std::vector< GLuint > vaos;
+
+	//-- hot reloading --
+
+	//re-read the file; re-upload only the vertex bytes that changed and patch drawables in live scenes whose mesh moved:
+	void reload(std::string const &filename);
+
+	//copy of the uploaded vertex data (only kept while HotReload::enabled()):
+	std::vector< char > reload_vertices;
 };
@@ -4,6 +4,10 @@ std::shared_ptr< Mode > Mode::current;
 
 SDL_Window *Mode::window = NULL;
 
+float Mode::tick_rate = 60.0f;
+uint32_t Mode::max_ticks = 8;
+float Mode::tick_alpha = 1.0f;
+
 void Mode::set_current(std::shared_ptr< Mode > const &new_current) {
 	current = new_current;
 	//NOTE: may wish to, e.g., trigger resize events on new current mode.
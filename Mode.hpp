@@ -3,7 +3,9 @@
 #include <SDL3/SDL.h>
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <memory>
+#include <cstdint>
 
 struct Mode : std::enable_shared_from_this< Mode > {
 	virtual ~Mode() { }
@@ -13,13 +15,28 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//The function should return 'true' if it handled the event.
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) { return false; }
 
-	//update is called at the start of a new frame, after events are handled:
+	//fixed_update is called zero or more times per frame, after events are handled, to advance simulation:
+	// 'step' is always exactly 1 / Mode::tick_rate seconds
+	// (if tick_rate is zero, it is instead called once per frame with the same 'elapsed' passed to update)
+	virtual void fixed_update(float step) { }
+
+	//update is called at the start of a new frame, after events are handled and fixed_update has run:
 	// 'elapsed' is time in seconds since the last call to 'update'
 	virtual void update(float elapsed) { }
 
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//prepare_draw is called instead of draw when main.cpp is running with a separate render thread:
+	// it runs on the update thread and should copy whatever drawing needs (e.g., a Scene::DrawList)
+	// into the returned function, which will be called later on the render thread (with the OpenGL context)
+	// while the next frame's events and updates are being processed.
+	// (main.cpp only calls prepare_draw once the previously returned function has started running,
+	//  so at most two prepared frames are ever alive at once)
+	//Returning nullptr (the default) means "not supported": draw will be called on the render thread
+	// while the update thread waits.
+	virtual std::function< void() > prepare_draw(glm::uvec2 const &drawable_size) { return nullptr; }
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
@@ -27,5 +44,13 @@ struct Mode : std::enable_shared_from_this< Mode > {
 
 	//Mode::window is the (global) SDL window:
 	static SDL_Window *window;
+
+	//Fixed-step simulation settings (used by main.cpp):
+	static float tick_rate; //fixed_update calls per second (0 = one variable-length fixed_update per frame)
+	static uint32_t max_ticks; //most fixed_update calls per frame; time past this is dropped instead of caught up
+
+	//How far the current frame is (in [0,1)) from the previous fixed_update to the next one:
+	// (use to interpolate simulation state when drawing; see Scene::Interpolation)
+	static float tick_alpha;
 };
 
@@ -31,7 +31,7 @@ struct PathFont {
 	const float *coords = nullptr;
 
 	//computed in constructor:
-	std::map< std::string, uint32_t > glyph_map;
+	std::map< std::string, uint32_t, std::less<> > glyph_map; //(std::less<> allows lookup by std::string_view)
 
 	//the default font:
 	static PathFont font;
@@ -8,9 +8,12 @@
 #include "Load.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
+#include "Replay.hpp"
+#include "SoundEffects.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <random>
 
 GLuint skewer_vao_for_lit = 0;
@@ -82,6 +85,9 @@ Load<Scene> campfire_scene(LoadTagDefault, []() -> Scene const *
 				drawable.pipeline.type  = mesh.type;
 				drawable.pipeline.start = mesh.start;
 				drawable.pipeline.count = mesh.count;
+
+				drawable.min = mesh.min;
+				drawable.max = mesh.max;
 			}
 		);
 	};
@@ -97,13 +103,19 @@ Load<Scene> campfire_scene(LoadTagDefault, []() -> Scene const *
 	return campfire; });
 
 Load<Sound::Sample> fire_crackle_sample(LoadTagDefault, []() -> Sound::Sample const *
-										{ return new Sound::Sample(data_path("fire.wav")); });
+										{
+											Sound::Sample *sample = new Sound::Sample(data_path("fire.wav"), Sound::Sample::Encoding::Block8);
+											sample->bus = Sound::Bus::Ambience;
+											return sample; });
 
 Load<Sound::Sample> sizzle_sample(LoadTagDefault, []() -> Sound::Sample const *
 								  { return new Sound::Sample(data_path("sizzle.wav")); });
 
 Load<Sound::Sample> background_sample(LoadTagDefault, []() -> Sound::Sample const *
-									  { return new Sound::Sample(data_path("song.wav")); });
+									  {
+										  Sound::Sample *sample = new Sound::Sample(data_path("song.wav"), Sound::Sample::Encoding::PCM16);
+										  sample->bus = Sound::Bus::Music;
+										  return sample; });
 
 Load<Sound::Sample> win_sample(LoadTagDefault, []() -> Sound::Sample const *
 							   { return new Sound::Sample(data_path("win.wav")); });
@@ -117,7 +129,7 @@ Load<Sound::Sample> almost_sample(LoadTagDefault, []() -> Sound::Sample const *
 Load<Sound::Sample> move_sample(LoadTagDefault, []() -> Sound::Sample const *
 								{ return new Sound::Sample(data_path("move.wav")); });
 
-PlayMode::PlayMode() : scene(*campfire_scene)
+PlayMode::PlayMode() : scene(*campfire_scene), rng(Replay::seed())
 {
 	for (auto &transform : scene.transforms)
 	{
@@ -135,14 +147,12 @@ PlayMode::PlayMode() : scene(*campfire_scene)
 			fire_root = &transform;
 	}
 
-	std::random_device rd;
-	std::mt19937 gen(rd());
 	std::uniform_real_distribution<float> goal_seconds_dist(7.0f, 15.0f);
-	goal_touched_seconds = goal_seconds_dist(gen);
+	goal_touched_seconds = goal_seconds_dist(rng);
 
 	std::uniform_real_distribution<float> fire_dist(-20.0f, 20.0f);
-	fire_root->position.x = fire_dist(gen);
-	fire_root->position.y = fire_dist(gen);
+	fire_root->position.x = fire_dist(rng);
+	fire_root->position.y = fire_dist(rng);
 
 	if (skewer_root == nullptr)
 		throw std::runtime_error("skewer_root not found.");
@@ -157,11 +167,42 @@ PlayMode::PlayMode() : scene(*campfire_scene)
 	if (fire_root == nullptr)
 		throw std::runtime_error("fire_root not found.");
 
+	// index drawables for proximity queries:
+	scene.spatial_index.build(scene);
+
+	// how far marshmallow drawables reach from their root (so a query this much wider than the
+	// touching distance finds every marshmallow whose root is close enough to the fire):
+	for (Scene::Drawable const &drawable : scene.drawables)
+	{
+		for (Scene::Transform const *root : {marshmallow_root, marshmallow_almost_root, marshmallow_golden_root, marshmallow_burnt_root})
+		{
+			bool under_root = false;
+			for (Scene::Transform const *t = drawable.transform; t; t = t->parent)
+			{
+				if (t == root)
+					under_root = true;
+			}
+			if (!under_root)
+				continue;
+			glm::vec3 origin = root->make_world_from_local()[3];
+			glm::mat4x3 world_from_object = drawable.transform->make_world_from_local();
+			for (uint32_t corner = 0; corner < 8; ++corner)
+			{
+				glm::vec3 local = glm::vec3((corner & 1) ? drawable.max.x : drawable.min.x, (corner & 2) ? drawable.max.y : drawable.min.y, (corner & 4) ? drawable.max.z : drawable.min.z);
+				marshmallow_reach = std::max(marshmallow_reach, glm::distance(origin, world_from_object * glm::vec4(local, 1.0f)));
+			}
+		}
+	}
+
 	// get pointer to camera for convenience:
 	if (scene.cameras.size() != 1)
 		throw std::runtime_error("Expecting scene to have exactly one camera, but it has " + std::to_string(scene.cameras.size()));
 	camera = &scene.cameras.front();
 
+	// bus effects: some reverb on the fire ambience, and a limiter so stacked sounds don't clip:
+	Sound::set_bus_effects(Sound::Bus::Ambience, {std::make_shared<Sound::Reverb>(0.6f, 0.5f, 0.3f)});
+	Sound::set_bus_effects(Sound::Bus::Master, {std::make_shared<Sound::Compressor>(-1.0f, std::numeric_limits<float>::infinity(), 0.0f, 0.1f)});
+
 	// start music loop playing:
 	//  (note: position will be over-ridden in update())
 	background_loop = Sound::loop_3D(*background_sample, 0.5f, skewer_root->position, 10.0f);
@@ -182,6 +223,11 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 			SDL_SetWindowRelativeMouseMode(Mode::window, false);
 			return true;
 		}
+		else if (evt.key.key == SDLK_F3)
+		{
+			show_audio_stats = !show_audio_stats;
+			return true;
+		}
 		else if (evt.key.key == SDLK_A)
 		{
 			left.downs += 1;
@@ -261,18 +307,32 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 	return false;
 }
 
-void PlayMode::update(float elapsed)
+void PlayMode::fixed_update(float elapsed)
 {
+	// remember where everything was at the start of this step (for drawing between steps):
+	interpolation.capture(scene);
+
 	// Track num seconds marshmallow touches fire
-	static std::shared_ptr<Sound::PlayingSample> sizzle_sound = nullptr;
 	bool is_touching_fire = false;
 	if (fire_visible)
 	{
-		float dist = glm::distance(marshmallow_root->position, fire_root->position);
-		float dist2 = glm::distance(marshmallow_golden_root->position, fire_root->position);
-		float dist3 = glm::distance(marshmallow_burnt_root->position, fire_root->position);
-		float dist4 = glm::distance(marshmallow_almost_root->position, fire_root->position);
-		if (dist < 5.0f || dist2 < 5.0f || dist3 < 5.0f || dist4 < 5.0f)
+		// is the (shown) marshmallow's root within reach of the fire?
+		// (the index only narrows this down to marshmallows near the fire; the test is the distance between roots)
+		near_fire.clear();
+		scene.spatial_index.query_radius(fire_root->position, 5.0f + marshmallow_reach, &near_fire);
+		bool marshmallow_near_fire = false;
+		for (Scene::Drawable const *drawable : near_fire)
+		{
+			for (Scene::Transform const *t = drawable->transform; t; t = t->parent)
+			{
+				if ((t == marshmallow_root || t == marshmallow_golden_root || t == marshmallow_burnt_root || t == marshmallow_almost_root)
+					&& glm::distance(t->position, fire_root->position) < 5.0f)
+				{
+					marshmallow_near_fire = true;
+				}
+			}
+		}
+		if (marshmallow_near_fire)
 		{
 
 			touching_seconds += elapsed;
@@ -313,7 +373,7 @@ void PlayMode::update(float elapsed)
 		{
 			fire_visible = false;
 			fire_timer = 0.0f;
-			fire_root->position = glm::vec3(1000.0f, 1000.0f, fire_root->position.z);
+			fire_root->enabled = false;
 		}
 	}
 	else
@@ -322,25 +382,27 @@ void PlayMode::update(float elapsed)
 		{
 			fire_visible = true;
 			fire_timer = 0.0f;
-			static std::random_device rd;
-			static std::mt19937 gen(rd());
-			static std::uniform_real_distribution<float> fire_dist(-20.0f, 20.0f);
-			fire_root->position.x = fire_dist(gen);
-			fire_root->position.y = fire_dist(gen);
+			std::uniform_real_distribution<float> fire_dist(-20.0f, 20.0f);
+			fire_root->position.x = fire_dist(rng);
+			fire_root->position.y = fire_dist(rng);
+			fire_root->enabled = true;
+
+			// vary pitch a little so the (frequently repeated) move sound doesn't get monotonous:
+			std::uniform_real_distribution<float> pitch_dist(0.85f, 1.15f);
+			float pitch = pitch_dist(rng);
 
 			// only play louder if we're still trying to get more fire time
 			if (touching_seconds < goal_touched_seconds)
 			{
-				Sound::play_3D(*move_sample, 0.5f, fire_root->position);
+				Sound::play_3D(*move_sample, 0.5f, fire_root->position, std::numeric_limits<float>::infinity(), pitch);
 			}
 			else
 			{
-				Sound::play_3D(*move_sample, 0.1f, fire_root->position);
+				Sound::play_3D(*move_sample, 0.1f, fire_root->position, std::numeric_limits<float>::infinity(), pitch);
 			}
 		}
 	}
 
-	static float rotation = 0.0f;
 	float amt = 0.0f;
 	if (left.pressed && !right.pressed)
 		amt += 1.0f;
@@ -391,18 +453,22 @@ void PlayMode::update(float elapsed)
 	// Make marshmallow follow skewer with offset
 	glm::vec3 follow_pos = skewer_root->position + skewer_root->rotation * glm::vec3(0, 0, 2.0f);
 	glm::quat follow_rot = skewer_root->rotation;
-	static bool played_win = false;
-	static bool played_lose = false;
-	static bool played_almost = false;
+
+	// Show only one marshmallow (the others are disabled, so they aren't drawn or found near the fire):
+	auto show_marshmallow = [&](Scene::Transform *shown)
+	{
+		for (Scene::Transform *root : {marshmallow_root, marshmallow_almost_root, marshmallow_golden_root, marshmallow_burnt_root})
+		{
+			root->enabled = (root == shown);
+		}
+		shown->position = follow_pos;
+		shown->rotation = follow_rot;
+	};
 
 	if (touching_seconds < goal_touched_seconds - 2.0f)
 	{
 		// Show normal marshmallow
-		marshmallow_root->position = follow_pos;
-		marshmallow_root->rotation = follow_rot;
-		marshmallow_almost_root->position = glm::vec3(1000.0f);
-		marshmallow_golden_root->position = glm::vec3(1000.0f);
-		marshmallow_burnt_root->position = glm::vec3(1000.0f);
+		show_marshmallow(marshmallow_root);
 		played_win = false;
 		played_lose = false;
 		played_almost = false;
@@ -410,11 +476,7 @@ void PlayMode::update(float elapsed)
 	else if (touching_seconds < goal_touched_seconds)
 	{
 		// Show almost marshmallow
-		marshmallow_almost_root->position = follow_pos;
-		marshmallow_almost_root->rotation = follow_rot;
-		marshmallow_root->position = glm::vec3(1000.0f);
-		marshmallow_golden_root->position = glm::vec3(1000.0f);
-		marshmallow_burnt_root->position = glm::vec3(1000.0f);
+		show_marshmallow(marshmallow_almost_root);
 		played_win = false;
 		played_lose = false;
 		if (!played_almost)
@@ -426,11 +488,7 @@ void PlayMode::update(float elapsed)
 	else if (touching_seconds < goal_touched_seconds + 1.0f)
 	{
 		// Show golden marshmallow
-		marshmallow_golden_root->position = follow_pos;
-		marshmallow_golden_root->rotation = follow_rot;
-		marshmallow_root->position = glm::vec3(1000.0f);
-		marshmallow_almost_root->position = glm::vec3(1000.0f);
-		marshmallow_burnt_root->position = glm::vec3(1000.0f);
+		show_marshmallow(marshmallow_golden_root);
 		if (!played_win)
 		{
 			Sound::play_3D(*win_sample, 0.8f, follow_pos);
@@ -442,11 +500,7 @@ void PlayMode::update(float elapsed)
 	else
 	{
 		// Show burnt marshmallow
-		marshmallow_burnt_root->position = follow_pos;
-		marshmallow_burnt_root->rotation = follow_rot;
-		marshmallow_root->position = glm::vec3(1000.0f);
-		marshmallow_golden_root->position = glm::vec3(1000.0f);
-		marshmallow_almost_root->position = glm::vec3(1000.0f);
+		show_marshmallow(marshmallow_burnt_root);
 		if (!played_lose)
 		{
 			Sound::play_3D(*lose_sample, 0.8f, follow_pos);
@@ -455,6 +509,13 @@ void PlayMode::update(float elapsed)
 		played_almost = false;
 	}
 
+	// Re-bin moved objects in the spatial index:
+	for (Scene::Transform const *moved : {skewer_root, marshmallow_root, marshmallow_golden_root, marshmallow_burnt_root, marshmallow_almost_root, fire_root})
+	{
+		scene.spatial_index.moved(moved);
+	}
+	scene.spatial_index.update();
+
 	// Set camera to follow skewer
 	{
 		const glm::vec3 camera_offset(0.0f, 23.0f, 8.0f);
@@ -477,64 +538,109 @@ void PlayMode::update(float elapsed)
 }
 
 void PlayMode::draw(glm::uvec2 const &drawable_size)
+{
+	prepare_draw(drawable_size)();
+}
+
+std::function<void()> PlayMode::prepare_draw(glm::uvec2 const &drawable_size)
 {
 	// update camera aspect ratio for drawable:
 	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
-	// set up light type and position for lit_color_texture_program:
-	//  TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f, -1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
-
-	glClearColor(0.02f, 0.02f, 0.08f, 1.0f);
-	glClearDepth(1.0f); // 1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS); // this is the default depth comparison function, but FYI you can change it.
-
-	scene.draw(*camera);
-
-	{ // use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
-		float aspect = float(drawable_size.x) / float(drawable_size.y);
-		DrawLines lines(glm::mat4(
-			1.0f / aspect, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 0.0f, 1.0f));
-
-		constexpr float H = 0.09f;
-		char buf[64];
-		if (touching_seconds < goal_touched_seconds - 2.0f)
-		{
-			snprintf(buf, sizeof(buf), "Toasted: %.1fs", touching_seconds);
-		}
-		else if (touching_seconds < goal_touched_seconds)
-		{
-			snprintf(buf, sizeof(buf), "Toasted: %.1fs - getting toasty..", touching_seconds);
-		}
-		else if (touching_seconds < goal_touched_seconds + 1.0f)
-		{
-			snprintf(buf, sizeof(buf), "Toasted: %.1fs - perfection!! :)", touching_seconds);
-		}
-		else
-		{
-			snprintf(buf, sizeof(buf), "Toasted: %.1fs -  noOO it's burnt :(", touching_seconds);
-		}
-		std::string touch_text = buf;
-		lines.draw_text(touch_text,
-						glm::vec3(-aspect + 0.1f * H, -1.0 + 0.1f * H, 0.0),
-						glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-						glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-		float ofs = 2.0f / drawable_size.y;
-		lines.draw_text(touch_text,
-						glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + 0.1f * H + ofs, 0.0),
-						glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-						glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+	// (alternating states, since the render thread may still be drawing the previous one)
+	DrawState *state = &draw_states[next_draw_state];
+	next_draw_state = (next_draw_state + 1) % 2;
+
+	// record the scene part way between the last two simulation steps:
+	interpolation.apply(Mode::tick_alpha);
+	scene.record(*camera, &state->draw_list);
+	interpolation.restore();
+
+	char *buf = state->hud;
+	size_t buf_size = sizeof(state->hud);
+	if (touching_seconds < goal_touched_seconds - 2.0f)
+	{
+		snprintf(buf, buf_size, "Toasted: %.1fs", touching_seconds);
+	}
+	else if (touching_seconds < goal_touched_seconds)
+	{
+		snprintf(buf, buf_size, "Toasted: %.1fs - getting toasty..", touching_seconds);
 	}
-	GL_ERRORS();
+	else if (touching_seconds < goal_touched_seconds + 1.0f)
+	{
+		snprintf(buf, buf_size, "Toasted: %.1fs - perfection!! :)", touching_seconds);
+	}
+	else
+	{
+		snprintf(buf, buf_size, "Toasted: %.1fs -  noOO it's burnt :(", touching_seconds);
+	}
+
+	if (show_audio_stats)
+	{
+		Sound::MixStats stats = Sound::mix_stats(1.0f);
+		snprintf(state->audio_stats[0], sizeof(state->audio_stats[0]), "Mix %.0fus avg %.0fus max (load %.0f%% max) %u-%u frames",
+				 stats.duration_avg_us, stats.duration_max_us, stats.load_max * 100.0f, stats.frames_min, stats.frames_max);
+		snprintf(state->audio_stats[1], sizeof(state->audio_stats[1]), "Voices %.1f (%u max) virtual %.1f peak %.2f underruns %u overruns %u",
+				 stats.voices_avg, stats.voices_max, stats.virtual_avg, stats.peak, stats.underruns, stats.overruns);
+	}
+	else
+	{
+		state->audio_stats[0][0] = state->audio_stats[1][0] = '\0';
+	}
+
+	// everything below only uses the state captured here, so it can run on the render thread:
+	// (n.b. this capture is small enough that std::function doesn't need to allocate)
+	return [state, drawable_size]()
+	{
+		// set up light type and position for lit_color_texture_program:
+		//  TODO: consider using the Light(s) in the scene to do this
+		glUseProgram(lit_color_texture_program->program);
+		glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
+		glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f, -1.0f)));
+		glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
+		glUseProgram(0);
+
+		glClearColor(0.02f, 0.02f, 0.08f, 1.0f);
+		glClearDepth(1.0f); // 1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS); // this is the default depth comparison function, but FYI you can change it.
+
+		state->draw_list.draw();
+
+		{ // use DrawLines to overlay some text:
+			glDisable(GL_DEPTH_TEST);
+			float aspect = float(drawable_size.x) / float(drawable_size.y);
+			DrawLines lines(glm::mat4(
+				1.0f / aspect, 0.0f, 0.0f, 0.0f,
+				0.0f, 1.0f, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f));
+
+			constexpr float H = 0.09f;
+			lines.draw_text(state->hud,
+							glm::vec3(-aspect + 0.1f * H, -1.0 + 0.1f * H, 0.0),
+							glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+							glm::u8vec4(0x00, 0x00, 0x00, 0x00));
+			float ofs = 2.0f / drawable_size.y;
+			lines.draw_text(state->hud,
+							glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + 0.1f * H + ofs, 0.0),
+							glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+							glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+
+			// mixer statistics (top left):
+			constexpr float S = 0.05f;
+			for (uint32_t i = 0; i < 2; ++i)
+			{
+				if (state->audio_stats[i][0] == '\0')
+					continue;
+				lines.draw_text(state->audio_stats[i],
+								glm::vec3(-aspect + 0.5f * S, 1.0f - (1.5f + 1.5f * i) * S, 0.0),
+								glm::vec3(S, 0.0f, 0.0f), glm::vec3(0.0f, S, 0.0f),
+								glm::u8vec4(0xff, 0xff, 0x80, 0x00));
+			}
+		}
+		GL_ERRORS();
+	};
 }
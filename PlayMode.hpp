@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <deque>
+#include <random>
 
 struct PlayMode : Mode {
 	void restart_game();
@@ -15,8 +16,9 @@ struct PlayMode : Mode {
 
 	//functions called by main loop:
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
-	virtual void update(float elapsed) override;
+	virtual void fixed_update(float step) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
+	virtual std::function< void() > prepare_draw(glm::uvec2 const &drawable_size) override;
 
 	//----- game state -----
 
@@ -32,6 +34,21 @@ struct PlayMode : Mode {
 	//local copy of the game scene (so code can change it during gameplay):
 	Scene scene;
 
+	//blends scene transforms between fixed updates when drawing:
+	Scene::Interpolation interpolation;
+
+	//what to draw, recorded by prepare_draw (two, since one may still be drawing on the render thread):
+	// (kept as members, so preparing a frame reuses their memory instead of allocating)
+	struct DrawState {
+		Scene::DrawList draw_list;
+		char hud[64] = "";
+		char audio_stats[2][96] = {"", ""}; //(empty unless show_audio_stats)
+	} draw_states[2];
+	uint32_t next_draw_state = 0;
+
+	//overlay mixer statistics (toggled with F3):
+	bool show_audio_stats = false;
+
 	Scene::Transform *skewer_root = nullptr;
 	Scene::Transform *marshmallow_root = nullptr;
 	Scene::Transform *marshmallow_golden_root = nullptr;
@@ -41,6 +58,24 @@ struct PlayMode : Mode {
 
 	float fire_timer = 0.0f;
 	bool fire_visible = false;
+
+	//all game randomness comes from here (seeded via Replay::seed() so recordings replay exactly):
+	std::mt19937 rng;
+
+	//skewer heading (radians around z):
+	float rotation = 0.0f;
+
+	//which marshmallow state sounds have played:
+	bool played_win = false;
+	bool played_lose = false;
+	bool played_almost = false;
+
+	std::shared_ptr< Sound::PlayingSample > sizzle_sound;
+
+	//drawables found near the fire (kept around to avoid re-allocating each frame):
+	std::vector< Scene::Drawable * > near_fire;
+	//farthest any marshmallow drawable's bounds reach from its root (widens the query above):
+	float marshmallow_reach = 0.0f;
 	
 	// curr marshmallow position
 	glm::vec3 marshmallow_pos;
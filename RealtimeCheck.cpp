@@ -0,0 +1,226 @@
+#include "RealtimeCheck.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+#ifdef REALTIME_CHECK_LIBC
+#include <cerrno>
+#include <ctime>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//local (to this file) checking state:
+namespace {
+	//(all constant-initialized, since allocation hooks can run before static constructors)
+	std::atomic< bool > enabled(false);
+	std::atomic< bool > ever_enabled(false);
+
+	thread_local uint32_t depth = 0; //nesting of RealtimeCheck::Scope on this thread
+	thread_local char const *scope_name = nullptr; //outermost scope's name
+	thread_local bool reporting = false; //(reports themselves may allocate; don't report those)
+
+	std::atomic< uint64_t > allocation_count(0);
+	std::atomic< uint64_t > free_count(0);
+	std::atomic< uint64_t > block_count(0);
+	std::atomic< uint32_t > traced(0);
+	//only the first few reports get stack traces (after that, just counted):
+	constexpr uint32_t const MaxTraces = 16;
+
+	void print_trace() {
+		constexpr int const MaxFrames = 32;
+		void *frames[MaxFrames];
+		#ifdef _WIN32
+		int count = int(CaptureStackBackTrace(0, MaxFrames, frames, nullptr));
+		for (int i = 0; i < count; ++i) {
+			std::fprintf(stderr, "    %p\n", frames[i]);
+		}
+		#else
+		int count = backtrace(frames, MaxFrames);
+		backtrace_symbols_fd(frames, count, STDERR_FILENO); //(writes directly, without allocating)
+		#endif
+	}
+}
+
+void RealtimeCheck::enable(bool enabled_) {
+	enabled = enabled_;
+	if (enabled_) ever_enabled = true;
+}
+
+void RealtimeCheck::enter(char const *name) {
+	if (depth == 0) scope_name = name;
+	depth += 1;
+}
+
+void RealtimeCheck::leave() {
+	depth -= 1;
+}
+
+bool RealtimeCheck::active() {
+	return depth != 0 && !reporting && enabled.load(std::memory_order_relaxed);
+}
+
+void RealtimeCheck::check(Kind kind, char const *what) {
+	if (!active()) return;
+	reporting = true;
+
+	if (kind == Kind::Allocate) allocation_count.fetch_add(1, std::memory_order_relaxed);
+	else if (kind == Kind::Free) free_count.fetch_add(1, std::memory_order_relaxed);
+	else block_count.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t index = traced.fetch_add(1, std::memory_order_relaxed);
+	if (index < MaxTraces) {
+		std::fprintf(stderr, "RealtimeCheck: %s in real-time code ('%s'):\n", what, scope_name);
+		print_trace();
+		if (index + 1 == MaxTraces) std::fprintf(stderr, "RealtimeCheck: (further problems will only be counted)\n");
+	}
+
+	reporting = false;
+}
+
+RealtimeCheck::Counts RealtimeCheck::counts() {
+	Counts ret;
+	ret.allocations = allocation_count.load(std::memory_order_relaxed);
+	ret.frees = free_count.load(std::memory_order_relaxed);
+	ret.blocks = block_count.load(std::memory_order_relaxed);
+	return ret;
+}
+
+void RealtimeCheck::report() {
+	if (!ever_enabled) return;
+	Counts c = counts();
+	std::cout << "Real-time check: " << c.allocations << " allocation(s), " << c.frees << " free(s), and " << c.blocks << " wait(s) on other threads in real-time code";
+	#ifndef REALTIME_CHECK_LIBC
+	std::cout << " (only C++ allocations and Sound's own locks on this platform)";
+	#endif
+	std::cout << "." << std::endl;
+}
+
+#ifdef REALTIME_CHECK_LIBC
+//Replacement C allocation functions (glibc provides the __libc_ versions for exactly this purpose);
+// these catch allocations from C libraries as well as from operator new (which uses malloc):
+extern "C" {
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void __libc_free(void *ptr);
+
+	void *malloc(size_t size) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Allocate, "malloc");
+		return __libc_malloc(size);
+	}
+	void *calloc(size_t count, size_t size) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Allocate, "calloc");
+		return __libc_calloc(count, size);
+	}
+	void *realloc(void *ptr, size_t size) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Allocate, "realloc");
+		return __libc_realloc(ptr, size);
+	}
+	void free(void *ptr) {
+		if (ptr) RealtimeCheck::check(RealtimeCheck::Kind::Free, "free");
+		__libc_free(ptr);
+	}
+}
+
+//Replacement pthread waiting functions, which forward to the next definition (i.e., libc's):
+// (looked up on first use; relaxed atomics, since every thread looks up the same value)
+namespace {
+	template< typename F >
+	F *next_function(std::atomic< F * > &next, char const *name, char const *version = nullptr) {
+		F *fn = next.load(std::memory_order_relaxed);
+		if (!fn) {
+			//(on some ABIs, condition variable functions have an older version that dlsym would find first,
+			// so ask for the current one -- but other ABIs only have one version, under another name)
+			if (version) fn = reinterpret_cast< F * >(dlvsym(RTLD_NEXT, name, version));
+			if (!fn) fn = reinterpret_cast< F * >(dlsym(RTLD_NEXT, name));
+			if (!fn) return nullptr; //(callers fall back to something slower but correct)
+			next.store(fn, std::memory_order_relaxed);
+		}
+		return fn;
+	}
+	std::atomic< int (*)(pthread_mutex_t *) > next_mutex_lock(nullptr);
+	std::atomic< int (*)(pthread_mutex_t *, struct timespec const *) > next_mutex_timedlock(nullptr);
+	std::atomic< int (*)(pthread_cond_t *, pthread_mutex_t *) > next_cond_wait(nullptr);
+	std::atomic< int (*)(pthread_cond_t *, pthread_mutex_t *, struct timespec const *) > next_cond_timedwait(nullptr);
+	#if __GLIBC_PREREQ(2, 30)
+	std::atomic< int (*)(pthread_mutex_t *, clockid_t, struct timespec const *) > next_mutex_clocklock(nullptr);
+	std::atomic< int (*)(pthread_cond_t *, pthread_mutex_t *, clockid_t, struct timespec const *) > next_cond_clockwait(nullptr);
+	#endif
+
+	//if libc's function can't be found, these stand in for it (a forwarding hook must never take the program down):
+	// (lock by polling; a condition wait may always wake spuriously, so just let other threads run first)
+	int fallback_lock(pthread_mutex_t *mutex, clockid_t clock, struct timespec const *abstime) {
+		while (true) {
+			int err = pthread_mutex_trylock(mutex);
+			if (err != EBUSY) return err;
+			if (abstime) {
+				struct timespec now;
+				clock_gettime(clock, &now);
+				if (now.tv_sec > abstime->tv_sec || (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec)) return ETIMEDOUT;
+			}
+			sched_yield();
+		}
+	}
+	int fallback_wait(pthread_mutex_t *mutex) {
+		pthread_mutex_unlock(mutex);
+		sched_yield();
+		return fallback_lock(mutex, CLOCK_REALTIME, nullptr);
+	}
+
+	//report a lock that would wait (trying it first, since an uncontended lock costs next to nothing):
+	bool locked_without_waiting(pthread_mutex_t *mutex, char const *what) {
+		if (!RealtimeCheck::active()) return false;
+		if (pthread_mutex_trylock(mutex) == 0) return true;
+		RealtimeCheck::check(RealtimeCheck::Kind::Block, what);
+		return false;
+	}
+}
+
+extern "C" {
+	int pthread_mutex_lock(pthread_mutex_t *mutex) {
+		if (locked_without_waiting(mutex, "pthread_mutex_lock waited")) return 0;
+		if (auto next = next_function(next_mutex_lock, "pthread_mutex_lock")) return next(mutex);
+		return fallback_lock(mutex, CLOCK_REALTIME, nullptr);
+	}
+	int pthread_mutex_timedlock(pthread_mutex_t *mutex, struct timespec const *abstime) {
+		if (locked_without_waiting(mutex, "pthread_mutex_timedlock waited")) return 0;
+		if (auto next = next_function(next_mutex_timedlock, "pthread_mutex_timedlock")) return next(mutex, abstime);
+		return fallback_lock(mutex, CLOCK_REALTIME, abstime);
+	}
+	int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Block, "pthread_cond_wait");
+		if (auto next = next_function(next_cond_wait, "pthread_cond_wait", "GLIBC_2.3.2")) return next(cond, mutex);
+		return fallback_wait(mutex);
+	}
+	int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, struct timespec const *abstime) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Block, "pthread_cond_timedwait");
+		if (auto next = next_function(next_cond_timedwait, "pthread_cond_timedwait", "GLIBC_2.3.2")) return next(cond, mutex, abstime);
+		return fallback_wait(mutex);
+	}
+	#if __GLIBC_PREREQ(2, 30)
+	//(these are used by std::timed_mutex::try_lock_for and std::condition_variable::wait_for/wait_until)
+	int pthread_mutex_clocklock(pthread_mutex_t *mutex, clockid_t clock, struct timespec const *abstime) {
+		if (locked_without_waiting(mutex, "pthread_mutex_clocklock waited")) return 0;
+		if (auto next = next_function(next_mutex_clocklock, "pthread_mutex_clocklock")) return next(mutex, clock, abstime);
+		return fallback_lock(mutex, clock, abstime);
+	}
+	int pthread_cond_clockwait(pthread_cond_t *cond, pthread_mutex_t *mutex, clockid_t clock, struct timespec const *abstime) {
+		RealtimeCheck::check(RealtimeCheck::Kind::Block, "pthread_cond_clockwait");
+		if (auto next = next_function(next_cond_clockwait, "pthread_cond_clockwait")) return next(cond, mutex, clock, abstime);
+		return fallback_wait(mutex);
+	}
+	#endif
+}
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * RealtimeCheck reports things real-time code (e.g., the audio mixer) must not do:
+ *
+ *  - Code that must never wait marks itself with RealtimeCheck::Scope
+ *    (Sound's mixer does this around each block it mixes, on every thread that mixes).
+ *  - While checking is enabled, heap allocations and frees made inside such a
+ *    scope are reported (with a stack trace) to stderr: on glibc by replacing
+ *    malloc/free themselves (so C libraries are caught too), elsewhere through
+ *    the replacement operator new/delete in FrameArena.cpp.
+ *  - So are waits on other threads: on glibc, pthread_mutex_lock/timedlock/clocklock are replaced
+ *    and report when the lock would actually block (an uncontended lock costs next to
+ *    nothing), and pthread_cond_wait/timedwait/clockwait always report -- this covers
+ *    std::mutex, std::condition_variable (including timed waits), and locks inside C
+ *    libraries (e.g., SDL). Elsewhere, only Sound::lock and the mixer's wait for its
+ *    helper threads are checked.
+ *
+ * Checking is off by default (main.cpp turns it on with --audio-rt-check);
+ * when off, each hook costs one thread-local read.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+//on glibc, malloc/free and pthread locking functions themselves are replaced (see RealtimeCheck.cpp);
+// elsewhere, operator new/delete and Sound's own lock points do the checking:
+#if defined(__GLIBC__)
+#define REALTIME_CHECK_LIBC 1
+#endif
+
+namespace RealtimeCheck {
+
+//turn checking on or off:
+void enable(bool enabled);
+
+//mark the calling thread as running real-time code named 'name' (scopes may nest):
+void enter(char const *name);
+void leave();
+struct Scope {
+	Scope(char const *name) { enter(name); }
+	~Scope() { leave(); }
+	Scope(Scope const &) = delete;
+	Scope &operator=(Scope const &) = delete;
+};
+
+//is the calling thread in real-time code (with checking enabled)? -- cheap, for hooks:
+bool active();
+
+//what went wrong:
+enum class Kind : uint8_t {
+	Allocate,
+	Free,
+	Block,
+};
+
+//called by hooks: if active(), count and report 'what' (the first few reports include stack traces):
+void check(Kind kind, char const *what);
+
+//counts of problems reported so far (blocks: locks that waited and condition variable waits):
+struct Counts {
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+	uint64_t blocks = 0;
+};
+Counts counts();
+
+//print a summary of counts() to stdout (does nothing if checking was never enabled):
+void report();
+
+} //namespace RealtimeCheck
@@ -0,0 +1,215 @@
+#include "Replay.hpp"
+
+#include "Bench.hpp"
+
+#include <chrono>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+//local (to this file) recording / playback state:
+namespace {
+	constexpr char const Magic[4] = {'r','p','l','0'};
+
+	std::ofstream out; //file being recorded (if open)
+	std::ifstream in; //file being played (if open)
+	std::string in_filename;
+
+	//playback bookkeeping:
+	bool have_frame = false; //has next_event reached a frame record?
+	float frame_elapsed = 0.0f; //...with this elapsed time
+	bool at_end = false; //has the end of the recording been reached?
+	uint32_t frames_played = 0;
+	std::vector< float > frame_times; //wall-clock milliseconds per played frame
+	std::chrono::high_resolution_clock::time_point last_frame;
+
+	template< typename T >
+	void put(T const &value) {
+		out.write(reinterpret_cast< char const * >(&value), sizeof(T));
+	}
+
+	template< typename T >
+	T get() {
+		T value;
+		if (!in.read(reinterpret_cast< char * >(&value), sizeof(T))) {
+			throw std::runtime_error("Replay '" + in_filename + "' ended in the middle of a record.");
+		}
+		return value;
+	}
+
+	//read the next record tag (returns false at end of file):
+	bool get_tag(char *tag) {
+		return bool(in.read(tag, 1));
+	}
+}
+
+void Replay::record(std::string const &filename) {
+	out.open(filename, std::ios::binary);
+	if (!out) throw std::runtime_error("Failed to open '" + filename + "' to record replay.");
+	out.write(Magic, 4);
+	std::cout << "Recording replay to '" << filename << "'." << std::endl;
+}
+
+void Replay::play(std::string const &filename) {
+	in_filename = filename;
+	in.open(filename, std::ios::binary);
+	if (!in) throw std::runtime_error("Failed to open replay '" + filename + "'.");
+	char magic[4];
+	if (!in.read(magic, 4) || std::memcmp(magic, Magic, 4) != 0) {
+		throw std::runtime_error("Replay '" + filename + "' has the wrong magic.");
+	}
+	std::cout << "Playing replay '" << filename << "'." << std::endl;
+	last_frame = std::chrono::high_resolution_clock::now();
+}
+
+void Replay::finish() {
+	if (out.is_open()) {
+		out.close();
+		if (out.fail()) std::cerr << "WARNING: failed to finish writing replay." << std::endl;
+	}
+	if (in.is_open()) {
+		in.close();
+		std::cout << "Replayed " << frames_played << " frames" << (at_end ? "" : " (stopped early)") << ":" << std::endl;
+		Bench::print_stats("frame", frame_times);
+	}
+}
+
+bool Replay::recording() {
+	return out.is_open();
+}
+
+bool Replay::playing() {
+	return in.is_open();
+}
+
+uint32_t Replay::seed() {
+	if (playing()) {
+		char tag;
+		if (!get_tag(&tag) || tag != 'S') {
+			throw std::runtime_error("Replay '" + in_filename + "' doesn't match the game (expected a seed).");
+		}
+		return get< uint32_t >();
+	}
+	uint32_t seed = std::random_device()();
+	if (recording()) {
+		put('S');
+		put(seed);
+	}
+	return seed;
+}
+
+void Replay::event(SDL_Event const &evt) {
+	if (!recording()) return;
+	switch (evt.type) {
+		case SDL_EVENT_KEY_DOWN:
+		case SDL_EVENT_KEY_UP:
+			put('E'); put(uint32_t(evt.type));
+			put(uint32_t(evt.key.scancode)); put(uint32_t(evt.key.key)); put(uint16_t(evt.key.mod)); put(uint8_t(evt.key.repeat));
+			break;
+		case SDL_EVENT_MOUSE_MOTION:
+			put('E'); put(uint32_t(evt.type));
+			put(uint32_t(evt.motion.state)); put(evt.motion.x); put(evt.motion.y); put(evt.motion.xrel); put(evt.motion.yrel);
+			break;
+		case SDL_EVENT_MOUSE_BUTTON_DOWN:
+		case SDL_EVENT_MOUSE_BUTTON_UP:
+			put('E'); put(uint32_t(evt.type));
+			put(uint8_t(evt.button.button)); put(uint8_t(evt.button.clicks)); put(evt.button.x); put(evt.button.y);
+			break;
+		case SDL_EVENT_MOUSE_WHEEL:
+			put('E'); put(uint32_t(evt.type));
+			put(evt.wheel.x); put(evt.wheel.y); put(uint32_t(evt.wheel.direction)); put(evt.wheel.mouse_x); put(evt.wheel.mouse_y);
+			break;
+		case SDL_EVENT_QUIT:
+			put('E'); put(uint32_t(evt.type));
+			break;
+		default:
+			break; //(window events, etc, don't affect simulation)
+	}
+}
+
+void Replay::frame(float elapsed) {
+	if (!recording()) return;
+	put('F');
+	put(elapsed);
+}
+
+bool Replay::next_event(SDL_Event *evt_) {
+	assert(evt_);
+	if (have_frame || at_end) return false;
+
+	char tag;
+	if (!get_tag(&tag)) {
+		at_end = true;
+		return false;
+	}
+	if (tag == 'F') {
+		frame_elapsed = get< float >();
+		have_frame = true;
+		return false;
+	}
+	if (tag != 'E') {
+		throw std::runtime_error("Replay '" + in_filename + "' doesn't match the game (unexpected '" + std::string(1, tag) + "' record).");
+	}
+
+	SDL_Event &evt = *evt_;
+	SDL_zero(evt);
+	evt.type = get< uint32_t >();
+	evt.common.timestamp = SDL_GetTicksNS();
+	switch (evt.type) {
+		case SDL_EVENT_KEY_DOWN:
+		case SDL_EVENT_KEY_UP:
+			evt.key.scancode = SDL_Scancode(get< uint32_t >());
+			evt.key.key = SDL_Keycode(get< uint32_t >());
+			evt.key.mod = SDL_Keymod(get< uint16_t >());
+			evt.key.repeat = get< uint8_t >() != 0;
+			evt.key.down = (evt.type == SDL_EVENT_KEY_DOWN);
+			break;
+		case SDL_EVENT_MOUSE_MOTION:
+			evt.motion.state = SDL_MouseButtonFlags(get< uint32_t >());
+			evt.motion.x = get< float >();
+			evt.motion.y = get< float >();
+			evt.motion.xrel = get< float >();
+			evt.motion.yrel = get< float >();
+			break;
+		case SDL_EVENT_MOUSE_BUTTON_DOWN:
+		case SDL_EVENT_MOUSE_BUTTON_UP:
+			evt.button.button = get< uint8_t >();
+			evt.button.clicks = get< uint8_t >();
+			evt.button.x = get< float >();
+			evt.button.y = get< float >();
+			evt.button.down = (evt.type == SDL_EVENT_MOUSE_BUTTON_DOWN);
+			break;
+		case SDL_EVENT_MOUSE_WHEEL:
+			evt.wheel.x = get< float >();
+			evt.wheel.y = get< float >();
+			evt.wheel.direction = SDL_MouseWheelDirection(get< uint32_t >());
+			evt.wheel.mouse_x = get< float >();
+			evt.wheel.mouse_y = get< float >();
+			break;
+		case SDL_EVENT_QUIT:
+			break;
+		default:
+			throw std::runtime_error("Replay '" + in_filename + "' has an unknown event type.");
+	}
+	return true;
+}
+
+bool Replay::next_frame(float *elapsed) {
+	assert(elapsed);
+	if (!have_frame) return false;
+	have_frame = false;
+	*elapsed = frame_elapsed;
+
+	//time since the previous frame started (i.e., how long that frame took):
+	auto now = std::chrono::high_resolution_clock::now();
+	if (frames_played > 0) {
+		frame_times.emplace_back(std::chrono::duration< float, std::milli >(now - last_frame).count());
+	}
+	last_frame = now;
+	frames_played += 1;
+	return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+ * Replay records everything that makes one run of the game differ from
+ * another -- input events, per-frame elapsed times, and random seeds -- to
+ * a compact binary file, and plays such a file back so that the exact same
+ * updates happen again (as fast as possible), e.g. to compare frame time
+ * profiles between builds.
+ *
+ * main.cpp calls Replay::event() for each input event before handling it and
+ * Replay::frame() with each frame's elapsed time; when playing, it takes both
+ * from Replay::next_event() / Replay::next_frame() instead of SDL + the clock.
+ *
+ * Game code that needs randomness should seed its generators from
+ * Replay::seed(), so that seeds are recorded / replayed in order.
+ *
+ * File format: "rpl0" magic, then a sequence of records, each a one-byte tag
+ * followed by a fixed payload (little-endian, as written by the host):
+ *   'S' uint32 seed
+ *   'E' uint32 event type + type-specific fields (keys, mouse buttons/motion/wheel, quit)
+ *   'F' float elapsed (ends the events for one frame)
+ *
+ */
+
+#include <SDL3/SDL.h>
+
+#include <string>
+#include <cstdint>
+
+namespace Replay {
+
+//start writing a recording to 'filename' (throws on failure):
+void record(std::string const &filename);
+
+//start playing back a recording from 'filename' (throws on failure):
+void play(std::string const &filename);
+
+//finish recording / playback (closes the file; prints playback timings):
+void finish();
+
+bool recording();
+bool playing();
+
+//a seed for random number generation (random, recorded, or replayed as appropriate):
+uint32_t seed();
+
+//--- recording ---
+
+//log an input event (other event types are ignored):
+void event(SDL_Event const &evt);
+
+//log the elapsed time for the frame whose events were just logged:
+void frame(float elapsed);
+
+//--- playback ---
+
+//get the next recorded event for the current frame; returns false once the frame's events are done:
+bool next_event(SDL_Event *evt);
+
+//get the current frame's elapsed time (after next_event returns false); returns false at the end of the recording:
+bool next_frame(float *elapsed);
+
+} //namespace Replay
@@ -2,10 +2,18 @@
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "Snapshot.hpp"
+#include "HotReload.hpp"
+#include "Jobs.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <array>
 #include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
 
 //-------------------------
 
@@ -63,6 +71,13 @@ glm::mat4x3 Scene::Transform::make_world_from_local() const {
 		return parent->make_world_from_local() * glm::mat4(make_parent_from_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
 	}
 }
+bool Scene::Transform::is_enabled() const {
+	for (Transform const *t = this; t; t = t->parent) {
+		if (!t->enabled) return false;
+	}
+	return true;
+}
+
 glm::mat4x3 Scene::Transform::make_local_from_world() const {
 	if (!parent) {
 		return make_local_from_parent();
@@ -84,79 +99,134 @@ void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
 	glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera.transform->make_local_from_world());
 	glm::mat4x3 light_from_world = glm::mat4x3(1.0f);
-	draw(clip_from_world, light_from_world);
+	draw(clip_from_world, light_from_world, camera.layer_mask);
 }
 
-void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world) const {
+//send one drawable's pipeline through OpenGL (used by Scene::draw and DrawList::draw):
+static void draw_pipeline(Scene::Drawable::Pipeline const &pipeline, glm::mat4x3 const &world_from_object, glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world) {
+	//skip any drawables without a shader program set:
+	if (pipeline.program == 0) return;
+	//skip any drawables that don't reference any vertex array:
+	if (pipeline.vao == 0) return;
+	//skip any drawables that don't contain any vertices:
+	if (pipeline.count == 0) return;
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
-		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+	//Set shader program:
+	glUseProgram(pipeline.program);
 
-		//skip any drawables without a shader program set:
-		if (pipeline.program == 0) continue;
-		//skip any drawables that don't reference any vertex array:
-		if (pipeline.vao == 0) continue;
-		//skip any drawables that don't contain any vertices:
-		if (pipeline.count == 0) continue;
+	//Set attribute sources:
+	glBindVertexArray(pipeline.vao);
 
+	//Configure program uniforms:
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+	//CLIP_FROM_OBJECT takes vertices from object space to clip space:
+	if (pipeline.CLIP_FROM_OBJECT_mat4 != -1U) {
+		glm::mat4 clip_from_object = clip_from_world * glm::mat4(world_from_object);
+		glUniformMatrix4fv(pipeline.CLIP_FROM_OBJECT_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_object));
+	}
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+	//the object-to-light matrix is used in the next two uniforms:
+	glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
 
-		//Configure program uniforms:
+	//CLIP_FROM_OBJECT takes vertices from object space to light space:
+	if (pipeline.LIGHT_FROM_OBJECT_mat4x3 != -1U) {
+		glUniformMatrix4x3fv(pipeline.LIGHT_FROM_OBJECT_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_object));
+	}
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 world_from_object = drawable.transform->make_world_from_local();
+	//LIGHT_FROM_NORMAL takes normals from object space to light space:
+	if (pipeline.LIGHT_FROM_NORMAL_mat3 != -1U) {
+		glm::mat3 light_from_normal = glm::inverse(glm::transpose(glm::mat3(light_from_object)));
+		glUniformMatrix3fv(pipeline.LIGHT_FROM_NORMAL_mat3, 1, GL_FALSE, glm::value_ptr(light_from_normal));
+	}
+
+	//set any requested custom uniforms:
+	if (pipeline.set_uniforms) pipeline.set_uniforms();
 
-		//CLIP_FROM_OBJECT takes vertices from object space to clip space:
-		if (pipeline.CLIP_FROM_OBJECT_mat4 != -1U) {
-			glm::mat4 clip_from_object = clip_from_world * glm::mat4(world_from_object);
-			glUniformMatrix4fv(pipeline.CLIP_FROM_OBJECT_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_object));
+	//set up textures:
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (pipeline.textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
 		}
+	}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
+	//draw the object:
+	glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
 
-		//CLIP_FROM_OBJECT takes vertices from object space to light space:
-		if (pipeline.LIGHT_FROM_OBJECT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.LIGHT_FROM_OBJECT_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_object));
+	//un-bind textures:
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (pipeline.textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(pipeline.textures[i].target, 0);
 		}
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
 
-		//LIGHT_FROM_NORMAL takes normals from object space to light space:
-		if (pipeline.LIGHT_FROM_NORMAL_mat3 != -1U) {
-			glm::mat3 light_from_normal = glm::inverse(glm::transpose(glm::mat3(light_from_object)));
-			glUniformMatrix3fv(pipeline.LIGHT_FROM_NORMAL_mat3, 1, GL_FALSE, glm::value_ptr(light_from_normal));
-		}
+void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world, uint32_t layer_mask) const {
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+	//Iterate through all drawables, sending each one to OpenGL:
+	for (auto const &drawable : drawables) {
+		assert(drawable.transform); //drawables *must* have a transform
+		//skip hidden drawables before doing any matrix work:
+		if (!(drawable.layers & layer_mask)) continue;
+		if (!drawable.transform->is_enabled()) continue;
+		//the object-to-world matrix is used in all of the transformation uniforms:
+		draw_pipeline(drawable.pipeline, drawable.transform->make_world_from_local(), clip_from_world, light_from_world);
+	}
 
-		//set up textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
-			}
-		}
+	glUseProgram(0);
+	glBindVertexArray(0);
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+	GL_ERRORS();
+}
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+void Scene::record(Camera const &camera, DrawList *list) const {
+	assert(camera.transform);
+	glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera.transform->make_local_from_world());
+	record(clip_from_world, glm::mat4x3(1.0f), list, camera.layer_mask);
+}
+
+void Scene::record(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world, DrawList *list_, uint32_t layer_mask) const {
+	assert(list_);
+	DrawList &list = *list_;
+	list.clip_from_world = clip_from_world;
+	list.light_from_world = light_from_world;
+	list.items.clear();
+	list.transforms.clear();
+	list.items.reserve(drawables.size());
+	list.transforms.reserve(drawables.size());
+	for (auto const &drawable : drawables) {
+		if (drawable.pipeline.program == 0 || drawable.pipeline.vao == 0 || drawable.pipeline.count == 0) continue;
+		assert(drawable.transform); //drawables *must* have a transform
+		if (!(drawable.layers & layer_mask)) continue;
+		if (!drawable.transform->is_enabled()) continue;
+		list.items.emplace_back(DrawList::Item{ drawable.pipeline, glm::mat4x3(1.0f) });
+		list.transforms.emplace_back(drawable.transform);
+	}
+
+	//evaluate world matrices (in parallel for big scenes):
+	Jobs::parallel_for(list.items.size(), WorldFromLocalGrain, [&list](size_t begin, size_t end){
+		for (size_t i = begin; i < end; ++i) {
+			list.items[i].world_from_object = list.transforms[i]->make_world_from_local();
+		}
+	});
+}
+
+void Scene::make_world_from_locals(std::vector< Transform const * > const &transforms, std::vector< glm::mat4x3 > *out_) {
+	assert(out_);
+	auto &out = *out_;
+	out.resize(transforms.size());
+	Jobs::parallel_for(transforms.size(), WorldFromLocalGrain, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; ++i) {
+			out[i] = transforms[i]->make_world_from_local();
 		}
-		glActiveTexture(GL_TEXTURE0);
+	});
+}
 
+void Scene::DrawList::draw() const {
+	for (auto const &item : items) {
+		draw_pipeline(item.pipeline, item.world_from_object, clip_from_world, light_from_world);
 	}
 
 	glUseProgram(0);
@@ -165,15 +235,10 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 	GL_ERRORS();
 }
 
+//-------------------------
 
-void Scene::load(std::string const &filename,
-	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
-
-	std::ifstream file(filename, std::ios::binary);
-
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
-
+namespace {
+	//transform hierarchy entries in the 'xfh0' chunk:
 	struct HierarchyEntry {
 		uint32_t parent;
 		uint32_t name_begin;
@@ -183,8 +248,75 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
+
+	//scenes that currently exist (only tracked while hot reloading):
+	std::unordered_set< Scene * > live_scenes;
+
+	//scene files already being watched:
+	std::unordered_set< std::string > watched_files;
+
+	//re-read a scene file's transforms and copy them onto same-named transforms loaded from it (and not moved since) in all live scenes:
+	void reload_transforms(std::string const &filename) {
+		std::ifstream file(filename, std::ios::binary);
+		std::vector< char > names;
+		read_chunk(file, "str0", &names);
+		std::vector< HierarchyEntry > hierarchy;
+		read_chunk(file, "xfh0", &hierarchy);
+
+		std::unordered_map< std::string, HierarchyEntry const * > by_name;
+		for (auto const &h : hierarchy) {
+			if (!(h.name_begin <= h.name_end && h.name_end <= names.size())) {
+				throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
+			}
+			by_name.emplace(std::string(names.begin() + h.name_begin, names.begin() + h.name_end), &h);
+		}
+
+		uint32_t updated = 0;
+		uint32_t skipped = 0;
+		std::unordered_set< std::string > found;
+		Scene::for_each_live_scene([&](Scene &scene) {
+			for (auto &t : scene.transforms) {
+				auto l = scene.loaded.find(&t);
+				if (l == scene.loaded.end() || l->second.filename != filename) continue;
+				auto f = by_name.find(t.name);
+				if (f == by_name.end()) continue;
+				found.insert(t.name);
+
+				Scene::Loaded &was = l->second;
+				if (t.position != was.position || t.rotation != was.rotation || t.scale != was.scale) {
+					//(the game has moved this transform since it was loaded, so leave it be)
+					skipped += 1;
+					continue;
+				}
+				t.position = was.position = f->second->position;
+				t.rotation = was.rotation = f->second->rotation;
+				t.scale = was.scale = f->second->scale;
+				scene.spatial_index.moved(&t);
+				updated += 1;
+			}
+			scene.spatial_index.update();
+		});
+		std::cout << "  updated " << updated << " transforms";
+		if (skipped) std::cout << " (skipped " << skipped << " moved by the game since loading)";
+		std::cout << "." << std::endl;
+		if (found.size() != by_name.size()) {
+			std::cerr << "WARNING: " << (by_name.size() - found.size()) << " transform(s) in '" << filename << "' don't exist in any live scene; adding objects requires a restart." << std::endl;
+		}
+	}
+}
+
+void Scene::for_each_live_scene(std::function< void(Scene &) > const &fn) {
+	for (Scene *scene : live_scenes) {
+		fn(*scene);
+	}
+}
+
+void Scene::load(std::string const &filename,
+	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+
+	std::vector< char > names;
+
 	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -193,7 +325,6 @@ void Scene::load(std::string const &filename,
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
 	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -203,7 +334,6 @@ void Scene::load(std::string const &filename,
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
 	std::vector< CameraEntry > loaded_cameras;
-	read_chunk(file, "cam0", &loaded_cameras);
 
 	struct LightEntry {
 		uint32_t transform;
@@ -215,8 +345,66 @@ void Scene::load(std::string const &filename,
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
 	std::vector< LightEntry > loaded_lights;
-	read_chunk(file, "lmp0", &loaded_lights);
 
+	//layout of this file's chunks in a startup snapshot:
+	struct SnapshotHeader {
+		Snapshot::Range< char > names;
+		Snapshot::Range< HierarchyEntry > hierarchy;
+		Snapshot::Range< MeshEntry > meshes;
+		Snapshot::Range< CameraEntry > cameras;
+		Snapshot::Range< LightEntry > lights;
+		Snapshot::Range< char > extra; //any trailing data (passed to load_extra)
+	};
+
+	std::ifstream file;
+	std::istringstream extra; //stands in for file when reading from a snapshot
+	std::istream *extra_from = &file;
+
+	std::string_view blob;
+	if (Snapshot::find(filename, &blob)) {
+		//chunks from snapshot:
+		SnapshotHeader const &header = Snapshot::header< SnapshotHeader >(blob);
+		auto copy = [&blob](auto const &range, auto *to) {
+			auto const *begin = Snapshot::get(blob, range);
+			to->assign(begin, begin + range.count);
+		};
+		copy(header.names, &names);
+		copy(header.hierarchy, &hierarchy);
+		copy(header.meshes, &meshes);
+		copy(header.cameras, &loaded_cameras);
+		copy(header.lights, &loaded_lights);
+		char const *extra_begin = Snapshot::get(blob, header.extra);
+		extra.str(std::string(extra_begin, extra_begin + header.extra.count));
+		extra_from = &extra;
+	} else {
+		//chunks from file:
+		file.open(filename, std::ios::binary);
+		read_chunk(file, "str0", &names);
+		read_chunk(file, "xfh0", &hierarchy);
+		read_chunk(file, "msh0", &meshes);
+		read_chunk(file, "cam0", &loaded_cameras);
+		read_chunk(file, "lmp0", &loaded_lights);
+
+		if (Snapshot::active()) { //record chunks (+ trailing data) for later runs:
+			std::vector< char > trailing;
+			auto at = file.tellg();
+			trailing.assign(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+			file.clear();
+			file.seekg(at);
+
+			Snapshot::Writer writer;
+			writer.reserve_header< SnapshotHeader >();
+			SnapshotHeader header;
+			header.names = writer.append(names);
+			header.hierarchy = writer.append(hierarchy);
+			header.meshes = writer.append(meshes);
+			header.cameras = writer.append(loaded_cameras);
+			header.lights = writer.append(loaded_lights);
+			header.extra = writer.append(trailing);
+			writer.set_header(header);
+			Snapshot::store(filename, std::move(writer.blob));
+		}
+	}
 
 	//--------------------------------
 	//Now that file is loaded, create transforms for hierarchy entries:
@@ -244,6 +432,10 @@ void Scene::load(std::string const &filename,
 		t->rotation = h.rotation;
 		t->scale = h.scale;
 
+		if (HotReload::enabled()) {
+			loaded.emplace(t, Loaded{ filename, h.position, h.rotation, h.scale });
+		}
+
 		hierarchy_transforms.emplace_back(t);
 	}
 	assert(hierarchy_transforms.size() == hierarchy.size());
@@ -302,26 +494,323 @@ void Scene::load(std::string const &filename,
 	}
 
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	load_extra(*extra_from, names, hierarchy_transforms);
 
-	if (file.peek() != EOF) {
+	if (extra_from->peek() != EOF) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
+	//transform edits can be patched into live scenes when the file changes:
+	// (the watch isn't tied to this scene, since edits apply to every copy of it)
+	if (HotReload::enabled() && watched_files.insert(filename).second) {
+		HotReload::watch(filename, &watched_files, [filename](){
+			reload_transforms(filename);
+		});
+	}
+
+
+}
+
+//-------------------------
+//Interpolation:
+
+void Scene::Interpolation::capture(Scene &scene) {
+	assert(simulated.empty() && "capture() called between apply() and restore()");
+	previous.clear();
+	previous.reserve(scene.transforms.size());
+	for (auto &t : scene.transforms) {
+		//(is_enabled, so children of hidden transforms count as hidden too)
+		previous.emplace_back(State{ &t, t.position, t.rotation, t.scale, t.is_enabled() });
+	}
+}
+
+void Scene::Interpolation::apply(float alpha) {
+	assert(simulated.empty() && "apply() called twice without restore()");
+	simulated.reserve(previous.size());
+	for (auto const &from : previous) {
+		Transform &t = *from.transform;
+		simulated.emplace_back(State{ &t, t.position, t.rotation, t.scale, t.enabled });
+		if (!from.enabled) continue; //(just appeared; don't sweep in from where it was hidden)
+		if (glm::distance(from.position, t.position) > snap_distance) continue;
+		t.position = glm::mix(from.position, t.position, alpha);
+		t.rotation = glm::slerp(from.rotation, t.rotation, alpha);
+		t.scale = glm::mix(from.scale, t.scale, alpha);
+	}
+}
+
+void Scene::Interpolation::restore() {
+	for (auto const &state : simulated) {
+		state.transform->position = state.position;
+		state.transform->rotation = state.rotation;
+		state.transform->scale = state.scale;
+	}
+	simulated.clear();
+}
+
+//-------------------------
+//Spatial index:
+
+namespace {
+	//grid coordinates are kept within +/- 2^20 cells so they can be packed into one 64-bit key:
+	constexpr int32_t const CellLimit = (1 << 20) - 1;
+
+	uint64_t pack_cell(int32_t x, int32_t y, int32_t z) {
+		return (uint64_t(x + CellLimit) << 42) | (uint64_t(y + CellLimit) << 21) | uint64_t(z + CellLimit);
+	}
+	glm::ivec3 unpack_cell(uint64_t key) {
+		return glm::ivec3(
+			int32_t((key >> 42) & 0x1fffff) - CellLimit,
+			int32_t((key >> 21) & 0x1fffff) - CellLimit,
+			int32_t(key & 0x1fffff) - CellLimit
+		);
+	}
+
+	glm::ivec3 cell_of(glm::vec3 const &p, float cell_size) {
+		glm::vec3 c = glm::clamp(glm::floor(p / cell_size), glm::vec3(float(-CellLimit)), glm::vec3(float(CellLimit)));
+		return glm::ivec3(c);
+	}
+
+	bool box_box(glm::vec3 const &amin, glm::vec3 const &amax, glm::vec3 const &bmin, glm::vec3 const &bmax) {
+		return amin.x <= bmax.x && bmin.x <= amax.x
+		    && amin.y <= bmax.y && bmin.y <= amax.y
+		    && amin.z <= bmax.z && bmin.z <= amax.z;
+	}
+
+	bool box_sphere(glm::vec3 const &min, glm::vec3 const &max, glm::vec3 const &center, float radius) {
+		glm::vec3 d = glm::clamp(center, min, max) - center;
+		return glm::dot(d, d) <= radius * radius;
+	}
+
+	//frustum planes (normals point inward) from a clip_from_world matrix:
+	std::array< glm::vec4, 6 > frustum_planes(glm::mat4 const &clip_from_world) {
+		glm::mat4 m = glm::transpose(clip_from_world); //rows of clip_from_world as columns
+		return {
+			m[3] + m[0], m[3] - m[0], //left, right
+			m[3] + m[1], m[3] - m[1], //bottom, top
+			m[3] + m[2], m[3] - m[2], //near, far (far is (0,0,0,+) -- i.e., always passes -- for infinite projections)
+		};
+	}
+
+	bool box_frustum(glm::vec3 const &min, glm::vec3 const &max, std::array< glm::vec4, 6 > const &planes) {
+		for (auto const &plane : planes) {
+			//corner of box farthest along plane normal:
+			glm::vec3 corner = glm::vec3(
+				plane.x >= 0.0f ? max.x : min.x,
+				plane.y >= 0.0f ? max.y : min.y,
+				plane.z >= 0.0f ? max.z : min.z
+			);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+		}
+		return true;
+	}
+}
+
+void Scene::SpatialIndex::clear() {
+	entries.clear();
+	cells.clear();
+	oversized.clear();
+	attached.clear();
+	children.clear();
+	dirty.clear();
+}
+
+void Scene::SpatialIndex::build(Scene &scene) {
+	clear();
+
+	for (auto const &transform : scene.transforms) {
+		if (transform.parent) children[transform.parent].emplace_back(&transform);
+	}
+
+	entries.reserve(scene.drawables.size());
+	for (auto &drawable : scene.drawables) {
+		attached[drawable.transform].emplace_back(uint32_t(entries.size()));
+		entries.emplace_back();
+		Entry &entry = entries.back();
+		entry.drawable = &drawable;
+		entry.cell_min = glm::ivec3(1); //(empty range: not stored anywhere yet)
+		entry.cell_max = glm::ivec3(0);
+	}
+
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		rebin(i);
+	}
+}
+
+void Scene::SpatialIndex::moved(Transform const *transform) {
+	dirty.emplace_back(transform);
+}
+
+void Scene::SpatialIndex::update() {
+	if (dirty.empty()) return;
+	update_count += 1;
+
+	//walk the subtrees under everything that moved:
+	std::vector< Transform const * > todo;
+	todo.swap(dirty);
+	while (!todo.empty()) {
+		Transform const *transform = todo.back();
+		todo.pop_back();
+
+		auto a = attached.find(transform);
+		if (a != attached.end()) {
+			for (uint32_t index : a->second) {
+				if (entries[index].updated == update_count) continue;
+				entries[index].updated = update_count;
+				rebin(index);
+			}
+		}
+
+		auto c = children.find(transform);
+		if (c != children.end()) {
+			todo.insert(todo.end(), c->second.begin(), c->second.end());
+		}
+	}
+	dirty.swap(todo); //(keep allocation around for next time)
+}
+
+void Scene::SpatialIndex::rebin(uint32_t index) {
+	Entry &entry = entries[index];
+	Drawable const &drawable = *entry.drawable;
+
+	//world-space box around the (transformed) object-space box:
+	glm::vec3 min = drawable.min;
+	glm::vec3 max = drawable.max;
+	if (!(min.x <= max.x && min.y <= max.y && min.z <= max.z)) {
+		min = max = glm::vec3(0.0f);
+	}
+	glm::mat4x3 world_from_object = drawable.transform->make_world_from_local();
+	glm::vec3 center = world_from_object * glm::vec4(0.5f * (min + max), 1.0f);
+	glm::vec3 half = 0.5f * (max - min);
+	glm::vec3 extent = glm::abs(world_from_object[0]) * half.x + glm::abs(world_from_object[1]) * half.y + glm::abs(world_from_object[2]) * half.z;
+	entry.min = center - extent;
+	entry.max = center + extent;
+
+	glm::ivec3 cell_min = cell_of(entry.min, cell_size);
+	glm::ivec3 cell_max = cell_of(entry.max, cell_size);
+	glm::ivec3 span = cell_max - cell_min + glm::ivec3(1);
+	bool too_big = uint64_t(span.x) * uint64_t(span.y) * uint64_t(span.z) > MaxCellsPerEntry;
+
+	//nothing to do if entry stays in the same place:
+	if (too_big && entry.oversized) return;
+	if (!too_big && !entry.oversized && cell_min == entry.cell_min && cell_max == entry.cell_max) return;
+
+	//remove from old place:
+	if (entry.oversized) {
+		oversized.erase(std::find(oversized.begin(), oversized.end(), index));
+	} else {
+		for (int32_t z = entry.cell_min.z; z <= entry.cell_max.z; ++z) {
+			for (int32_t y = entry.cell_min.y; y <= entry.cell_max.y; ++y) {
+				for (int32_t x = entry.cell_min.x; x <= entry.cell_max.x; ++x) {
+					auto f = cells.find(pack_cell(x, y, z));
+					assert(f != cells.end());
+					auto &list = f->second;
+					auto at = std::find(list.begin(), list.end(), index);
+					assert(at != list.end());
+					*at = list.back();
+					list.pop_back();
+					//(empty lists are kept, so objects moving back and forth between cells don't allocate)
+				}
+			}
+		}
+	}
+
+	//add in new place:
+	entry.oversized = too_big;
+	if (too_big) {
+		oversized.emplace_back(index);
+		entry.cell_min = glm::ivec3(1);
+		entry.cell_max = glm::ivec3(0);
+	} else {
+		entry.cell_min = cell_min;
+		entry.cell_max = cell_max;
+		for (int32_t z = cell_min.z; z <= cell_max.z; ++z) {
+			for (int32_t y = cell_min.y; y <= cell_max.y; ++y) {
+				for (int32_t x = cell_min.x; x <= cell_max.x; ++x) {
+					cells[pack_cell(x, y, z)].emplace_back(index);
+				}
+			}
+		}
+	}
+}
+
+template< typename CellTest, typename Test >
+void Scene::SpatialIndex::query_cells(glm::ivec3 const &cell_min, glm::ivec3 const &cell_max, CellTest const &cell_test, Test const &test, std::vector< Drawable * > *out) const {
+	assert(out);
+	query_count += 1;
+
+	auto visit = [&](uint32_t index) {
+		Entry const &entry = entries[index];
+		if (entry.visited == query_count) return; //(already reported via another cell)
+		entry.visited = query_count;
+		if (test(entry.min, entry.max) && entry.drawable->transform->is_enabled()) out->emplace_back(entry.drawable);
+	};
+
+	glm::ivec3 span = cell_max - cell_min + glm::ivec3(1);
+	if (uint64_t(span.x) * uint64_t(span.y) * uint64_t(span.z) <= cells.size()) {
+		//look up each cell in range:
+		for (int32_t z = cell_min.z; z <= cell_max.z; ++z) {
+			for (int32_t y = cell_min.y; y <= cell_max.y; ++y) {
+				for (int32_t x = cell_min.x; x <= cell_max.x; ++x) {
+					auto f = cells.find(pack_cell(x, y, z));
+					if (f == cells.end()) continue;
+					for (uint32_t index : f->second) visit(index);
+				}
+			}
+		}
+	} else {
+		//range covers more cells than are occupied, so walk the occupied ones instead:
+		for (auto const &[key, list] : cells) {
+			glm::ivec3 c = unpack_cell(key);
+			if (c.x < cell_min.x || c.x > cell_max.x || c.y < cell_min.y || c.y > cell_max.y || c.z < cell_min.z || c.z > cell_max.z) continue;
+			if (!cell_test(glm::vec3(c) * cell_size, glm::vec3(c + glm::ivec3(1)) * cell_size)) continue;
+			for (uint32_t index : list) visit(index);
+		}
+	}
+
+	for (uint32_t index : oversized) visit(index);
+}
+
+void Scene::SpatialIndex::query_radius(glm::vec3 const &center, float radius, std::vector< Drawable * > *out) const {
+	auto test = [&](glm::vec3 const &min, glm::vec3 const &max) {
+		return box_sphere(min, max, center, radius);
+	};
+	query_cells(cell_of(center - glm::vec3(radius), cell_size), cell_of(center + glm::vec3(radius), cell_size), test, test, out);
+}
 
+void Scene::SpatialIndex::query_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< Drawable * > *out) const {
+	auto test = [&](glm::vec3 const &bmin, glm::vec3 const &bmax) {
+		return box_box(min, max, bmin, bmax);
+	};
+	query_cells(cell_of(min, cell_size), cell_of(max, cell_size), test, test, out);
+}
 
+void Scene::SpatialIndex::query_frustum(glm::mat4 const &clip_from_world, std::vector< Drawable * > *out) const {
+	std::array< glm::vec4, 6 > planes = frustum_planes(clip_from_world);
+	auto test = [&](glm::vec3 const &min, glm::vec3 const &max) {
+		return box_frustum(min, max, planes);
+	};
+	//(frusta may be unbounded, so visit all occupied cells, culling them against the planes:)
+	query_cells(glm::ivec3(-CellLimit), glm::ivec3(CellLimit), test, test, out);
 }
 
 //-------------------------
 
-Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+Scene::Scene() {
+	if (HotReload::enabled()) live_scenes.insert(this);
+}
+
+Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) : Scene() {
 	load(filename, on_drawable);
 }
 
-Scene::Scene(Scene const &other) {
+Scene::Scene(Scene const &other) : Scene() {
 	set(other);
 }
 
+Scene::~Scene() {
+	live_scenes.erase(this);
+}
+
 Scene &Scene::operator=(Scene const &other) {
 	set(other);
 	return *this;
@@ -329,6 +818,9 @@ Scene &Scene::operator=(Scene const &other) {
 
 void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
 
+	//spatial index refers to the old drawables; it needs to be re-built for the copy:
+	spatial_index.clear();
+
 	std::unordered_map< Transform const *, Transform * > t2t_temp;
 	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
 
@@ -346,6 +838,7 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		transforms.back().rotation = t.rotation;
 		transforms.back().scale = t.scale;
 		transforms.back().parent = t.parent; //will update later
+		transforms.back().enabled = t.enabled;
 
 		//store mapping between transforms old and new:
 		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
@@ -357,6 +850,12 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		t.parent = transform_to_transform.at(t.parent);
 	}
 
+	//copy other's record of where its transforms were loaded from:
+	loaded.clear();
+	for (auto const &[t, l] : other.loaded) {
+		loaded.emplace(transform_to_transform.at(t), l);
+	}
+
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
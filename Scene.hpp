@@ -15,6 +15,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <limits>
 #include <list>
 #include <memory>
 #include <functional>
@@ -35,6 +36,11 @@ struct Scene {
 		//The transform above may be relative to some parent transform:
 		Transform *parent = nullptr;
 
+		//Disabled transforms (and everything under them) aren't drawn or returned by spatial queries:
+		bool enabled = true;
+		// ..is this transform and every one of its parents enabled?
+		bool is_enabled() const;
+
 		//It is often convenient to construct matrices representing this transformation:
 		// ..relative to its parent:
 		glm::mat4x3 make_parent_from_local() const;
@@ -54,6 +60,9 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//drawn only by cameras whose layer_mask shares a bit with this:
+		uint32_t layers = 1;
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -79,6 +88,11 @@ struct Scene {
 				GLenum target = GL_TEXTURE_2D;
 			} textures[TextureCount];
 		} pipeline;
+
+		//object-space bounding box (e.g., from Mesh::min/max); used by SpatialIndex:
+		// (if left empty, the drawable is indexed as a point at its transform's origin)
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
 	};
 
 	struct Camera {
@@ -91,6 +105,7 @@ struct Scene {
 		float fovy = glm::radians(60.0f); //vertical fov (in radians)
 		float aspect = 1.0f; //x / y
 		float near = 0.01f; //near plane
+		uint32_t layer_mask = ~0u; //which drawable layers this camera draws
 		//computed from the above:
 		glm::mat4 make_projection() const;
 	};
@@ -122,11 +137,118 @@ struct Scene {
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//transforms loaded from scene files, with the values they were loaded with (only tracked while HotReload::enabled()):
+	// when a scene file changes, its edits are copied only onto transforms loaded from that file,
+	// and only onto those the game hasn't moved since (so runtime-driven transforms keep their state):
+	struct Loaded {
+		std::string filename;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	std::unordered_map< Transform const *, Loaded > loaded;
+
+	//An 'Interpolation' smooths drawing of a scene simulated at a fixed rate (see Mode::fixed_update):
+	// - call capture() at the start of each fixed step to remember where transforms were;
+	// - when drawing, call apply(Mode::tick_alpha) to blend transforms between the last two steps,
+	//   draw, then call restore() to put the simulated state back.
+	struct Interpolation {
+		//transforms that move farther than this in one step are treated as teleports (drawn at their new position):
+		float snap_distance = std::numeric_limits< float >::infinity();
+
+		void capture(Scene &scene);
+		void apply(float alpha);
+		void restore();
+
+		//-- internals --
+		struct State {
+			Transform *transform;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+			bool enabled; //(transforms that were disabled -- or under a disabled parent -- at capture() are drawn where they are now)
+		};
+		std::vector< State > previous; //state as of the last capture()
+		std::vector< State > simulated; //state replaced by apply() (put back by restore())
+	};
+
+	//A 'SpatialIndex' bins drawables by world-space bounds (in a uniform hash grid) for "what's near here?" queries:
+	// - call build() once drawables exist (and again after adding/removing drawables or re-parenting transforms)
+	// - call moved() for each transform your code moves, then update() before querying;
+	//   update() only re-bins drawables under the transforms that moved.
+	struct SpatialIndex {
+		float cell_size = 4.0f; //world units per grid cell (takes effect on build())
+
+		void build(Scene &scene);
+		void clear();
+
+		//note that 'transform' (and so everything attached to it or its descendants) moved:
+		void moved(Transform const *transform);
+		//re-bin drawables under transforms passed to moved() since the last update():
+		void update();
+
+		//queries append every drawable whose world bounds touch the given shape to 'out':
+		void query_radius(glm::vec3 const &center, float radius, std::vector< Drawable * > *out) const;
+		void query_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< Drawable * > *out) const;
+		// (frustum given by a clip_from_world matrix, as passed to draw(); infinite far planes are fine)
+		void query_frustum(glm::mat4 const &clip_from_world, std::vector< Drawable * > *out) const;
+
+		//-- internals --
+		struct Entry {
+			Drawable *drawable = nullptr;
+			glm::vec3 min, max; //world-space bounds
+			glm::ivec3 cell_min, cell_max; //range of cells entry is stored in (if not oversized)
+			bool oversized = false; //stored in 'oversized' instead of in cells
+			uint32_t updated = 0; //last update() that re-binned this entry
+			mutable uint32_t visited = 0; //last query that reported this entry
+		};
+		std::vector< Entry > entries;
+		std::unordered_map< uint64_t, std::vector< uint32_t > > cells; //entry indices by packed cell coordinate (cells that empty out are kept)
+		std::vector< uint32_t > oversized; //entries covering more than MaxCellsPerEntry cells (checked by every query)
+		std::unordered_map< Transform const *, std::vector< uint32_t > > attached; //entries whose drawable uses each transform
+		std::unordered_map< Transform const *, std::vector< Transform const * > > children;
+		std::vector< Transform const * > dirty; //passed to moved() since last update()
+		uint32_t update_count = 0;
+		mutable uint32_t query_count = 0;
+
+		static constexpr uint32_t const MaxCellsPerEntry = 64;
+
+		void rebin(uint32_t index);
+		template< typename CellTest, typename Test >
+		void query_cells(glm::ivec3 const &cell_min, glm::ivec3 const &cell_max, CellTest const &cell_test, Test const &test, std::vector< Drawable * > *out) const;
+	} spatial_index;
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
+	// (drawables on transforms that aren't enabled, or not in the camera's layer_mask, are skipped)
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
-	void draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world = glm::mat4x3(1.0f)) const;
+	void draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world = glm::mat4x3(1.0f), uint32_t layer_mask = ~0u) const;
+
+	//A 'DrawList' is a copy of everything draw() would send to OpenGL (pipelines + world matrices),
+	// so that drawing can happen later -- e.g., on a render thread while the scene keeps changing:
+	// (n.b. any pipeline 'set_uniforms' functions are called when the list is drawn)
+	struct DrawList {
+		glm::mat4 clip_from_world = glm::mat4(1.0f);
+		glm::mat4x3 light_from_world = glm::mat4x3(1.0f);
+		struct Item {
+			Drawable::Pipeline pipeline;
+			glm::mat4x3 world_from_object;
+		};
+		std::vector< Item > items;
+		std::vector< Transform const * > transforms; //transform each item came from (used while recording)
+
+		void draw() const;
+	};
+
+	//..record what draw() would do into a DrawList:
+	void record(Camera const &camera, DrawList *list) const;
+	void record(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world, DrawList *list, uint32_t layer_mask = ~0u) const;
+
+	//compute make_world_from_local() for many transforms at once:
+	// (split over Jobs workers in chunks of WorldFromLocalGrain, so small scenes stay on the calling thread)
+	static void make_world_from_locals(std::vector< Transform const * > const &transforms, std::vector< glm::mat4x3 > *out);
+	static constexpr size_t WorldFromLocalGrain = 1024;
 
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
@@ -140,7 +262,8 @@ struct Scene {
 	virtual void load_extra(std::istream &from, std::vector< char > const &str0, std::vector< Transform * > const &xfh0) { }
 
 	//empty scene:
-	Scene() = default;
+	Scene();
+	virtual ~Scene();
 
 	//load a scene:
 	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
@@ -150,4 +273,8 @@ struct Scene {
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+
+	//call 'fn' on every scene that currently exists:
+	// (scenes are only tracked while HotReload::enabled(); used to patch reloaded assets into live scenes -- see 'loaded')
+	static void for_each_live_scene(std::function< void(Scene &) > const &fn);
 };
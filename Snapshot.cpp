@@ -0,0 +1,216 @@
+#include "Snapshot.hpp"
+#include "MappedFile.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <map>
+#include <cassert>
+
+//local (to this file) data used by the snapshot system:
+namespace {
+	//bump this whenever any loader changes the layout of its blobs:
+	constexpr uint32_t const SnapshotVersion = 2;
+
+	//file layout: FileHeader, then (at entries_offset) FileEntry[entry_count];
+	// keys and blobs are stored at the offsets listed in the entries (blobs are 16-byte aligned).
+	struct FileHeader {
+		char magic[4] = {'s','n','p','0'};
+		uint32_t version = SnapshotVersion;
+		uint32_t entry_count = 0;
+		uint32_t reserved = 0;
+		uint64_t entries_offset = 0;
+	};
+	static_assert(sizeof(FileHeader) == 4 + 4 + 4 + 4 + 8, "FileHeader is packed.");
+
+	struct FileEntry {
+		uint64_t key_offset, key_size;
+		uint64_t blob_offset, blob_size;
+		uint64_t source_size; //size of source file when blob was recorded
+		int64_t source_time; //modification time of source file when blob was recorded
+	};
+	static_assert(sizeof(FileEntry) == 6 * 8, "FileEntry is packed.");
+
+	//size + modification time of a source file:
+	struct Stamp {
+		uint64_t size = 0;
+		int64_t time = 0;
+	};
+	bool get_stamp(std::string const &source, Stamp *stamp) {
+		std::error_code ec;
+		auto size = std::filesystem::file_size(source, ec);
+		if (ec) return false;
+		auto time = std::filesystem::last_write_time(source, ec);
+		if (ec) return false;
+		stamp->size = uint64_t(size);
+		stamp->time = int64_t(time.time_since_epoch().count());
+		return true;
+	}
+
+	struct Entry {
+		Stamp stamp;
+		std::string_view mapped; //blob in the mapped file (if any)
+		std::vector< char > stored; //blob recorded during this run (if any)
+		bool used = false; //was the entry found or stored during this run?
+	};
+
+	struct State {
+		std::string filename;
+		std::unique_ptr< MappedFile > file;
+		std::map< std::string, Entry > entries;
+		bool dirty = false; //did anything get stored?
+	};
+	std::unique_ptr< State > state;
+
+	void read_entries(State &s) {
+		MappedFile const &file = *s.file;
+		std::string_view all(file.data, file.size);
+		FileHeader const &header = Snapshot::header< FileHeader >(all);
+		if (std::string(header.magic, 4) != "snp0" || header.version != SnapshotVersion) {
+			throw std::runtime_error("Snapshot has wrong magic or version.");
+		}
+		Snapshot::Range< FileEntry > range;
+		range.offset = header.entries_offset;
+		range.count = header.entry_count;
+		FileEntry const *entries = Snapshot::get(all, range);
+		for (uint32_t i = 0; i < header.entry_count; ++i) {
+			FileEntry const &fe = entries[i];
+			Snapshot::Range< char > key_range, blob_range;
+			key_range.offset = fe.key_offset;
+			key_range.count = fe.key_size;
+			blob_range.offset = fe.blob_offset;
+			blob_range.count = fe.blob_size;
+			std::string key(Snapshot::get(all, key_range), fe.key_size);
+			Entry &entry = s.entries[key];
+			entry.stamp.size = fe.source_size;
+			entry.stamp.time = fe.source_time;
+			entry.mapped = std::string_view(Snapshot::get(all, blob_range), fe.blob_size);
+		}
+	}
+
+	void write_entries(State &s) {
+		//entries that weren't used this run are dropped (their source is no longer loaded):
+		std::vector< std::pair< std::string const *, Entry const * > > to_write;
+		for (auto const &[key, entry] : s.entries) {
+			if (entry.used) to_write.emplace_back(&key, &entry);
+		}
+
+		//lay out file:
+		FileHeader header;
+		header.entry_count = uint32_t(to_write.size());
+		uint64_t offset = sizeof(FileHeader);
+		header.entries_offset = offset;
+		offset += sizeof(FileEntry) * to_write.size();
+
+		std::vector< FileEntry > file_entries;
+		file_entries.reserve(to_write.size());
+		for (auto const &[key, entry] : to_write) {
+			std::string_view blob = entry->stored.empty() ? entry->mapped : std::string_view(entry->stored.data(), entry->stored.size());
+			FileEntry fe;
+			fe.key_offset = offset;
+			fe.key_size = key->size();
+			offset += key->size();
+			offset = (offset + 15) & ~uint64_t(15);
+			fe.blob_offset = offset;
+			fe.blob_size = blob.size();
+			offset += blob.size();
+			fe.source_size = entry->stamp.size;
+			fe.source_time = entry->stamp.time;
+			file_entries.emplace_back(fe);
+		}
+
+		//write to a temporary file first, since mapped blobs may still be coming from the old file:
+		std::string temp = s.filename + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary);
+			out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+			out.write(reinterpret_cast< char const * >(file_entries.data()), file_entries.size() * sizeof(FileEntry));
+			uint64_t at = sizeof(FileHeader) + file_entries.size() * sizeof(FileEntry);
+			static char const zeros[16] = {0};
+			for (uint32_t i = 0; i < to_write.size(); ++i) {
+				std::string const &key = *to_write[i].first;
+				Entry const &entry = *to_write[i].second;
+				std::string_view blob = entry.stored.empty() ? entry.mapped : std::string_view(entry.stored.data(), entry.stored.size());
+				out.write(key.data(), key.size());
+				at += key.size();
+				out.write(zeros, file_entries[i].blob_offset - at);
+				at = file_entries[i].blob_offset;
+				out.write(blob.data(), blob.size());
+				at += blob.size();
+			}
+			if (!out) {
+				throw std::runtime_error("Failed to write snapshot '" + temp + "'.");
+			}
+		}
+		s.file.reset(); //release mapping before replacing the file
+		std::filesystem::rename(temp, s.filename);
+	}
+}
+
+void Snapshot::begin(std::string const &filename) {
+	assert(!state && "Snapshot::begin should only be called once before Snapshot::finish");
+	state = std::make_unique< State >();
+	state->filename = filename;
+
+	if (!std::filesystem::exists(filename)) {
+		std::cout << "Snapshot '" << filename << "' doesn't exist yet; will record one." << std::endl;
+		return;
+	}
+	try {
+		state->file = std::make_unique< MappedFile >(filename);
+		read_entries(*state);
+	} catch (std::exception &e) {
+		std::cerr << "WARNING: ignoring snapshot '" << filename << "': " << e.what() << std::endl;
+		state->entries.clear();
+		state->file.reset();
+	}
+}
+
+void Snapshot::finish() {
+	if (!state) return;
+	uint32_t stale = 0;
+	for (auto const &[key, entry] : state->entries) {
+		if (!entry.used) ++stale;
+	}
+	if (state->dirty || stale) {
+		std::cout << "Writing snapshot '" << state->filename << "'." << std::endl;
+		write_entries(*state);
+	}
+	state.reset();
+}
+
+bool Snapshot::active() {
+	return state != nullptr;
+}
+
+bool Snapshot::find(std::string const &source, std::string_view *blob) {
+	assert(blob);
+	if (!state) return false;
+	auto f = state->entries.find(source);
+	if (f == state->entries.end() || f->second.mapped.data() == nullptr) return false;
+	Stamp stamp;
+	if (!get_stamp(source, &stamp)
+	 || stamp.size != f->second.stamp.size
+	 || stamp.time != f->second.stamp.time) {
+		std::cout << "Snapshot entry for '" << source << "' is stale." << std::endl;
+		return false;
+	}
+	f->second.used = true;
+	*blob = f->second.mapped;
+	return true;
+}
+
+void Snapshot::store(std::string const &source, std::vector< char > &&blob) {
+	if (!state) return;
+	Entry &entry = state->entries[source];
+	if (!get_stamp(source, &entry.stamp)) {
+		std::cerr << "WARNING: can't stat '" << source << "'; not adding it to snapshot." << std::endl;
+		state->entries.erase(source);
+		return;
+	}
+	entry.mapped = std::string_view();
+	entry.stored = std::move(blob);
+	entry.used = true;
+	state->dirty = true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * A startup snapshot stores the fully-built CPU-side state of loaded
+ * assets (mesh tables + vertex data, scene hierarchies, decoded samples)
+ * in a single relocatable file, so later runs can skip parsing,
+ * validation, and decoding.
+ *
+ * Usage (from main.cpp):
+ *
+ *   Snapshot::begin("path/to/file.snapshot"); //maps file if it exists
+ *   call_load_functions(); //loaders pull state from the snapshot or record it
+ *   Snapshot::finish(); //(re-)writes the file if anything was missing or stale
+ *
+ * Loaders use Snapshot::find() / Snapshot::store() keyed by source filename.
+ * Entries remember the size + modification time of their source file and
+ * are ignored if the source changes.
+ *
+ * Inside an entry, all 'pointers' are byte offsets from the start of the
+ * entry (see Snapshot::Range), so the file can be used directly from a
+ * memory mapping wherever it lands.
+ *
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Snapshot {
+
+//start using the snapshot in 'filename' (call before call_load_functions()):
+void begin(std::string const &filename);
+
+//stop using the snapshot (call after call_load_functions()):
+// writes a new snapshot file if any loader recorded fresh state.
+void finish();
+
+//is a snapshot in use? (i.e., should loaders call store()?)
+bool active();
+
+//look up state stored for the source file 'source':
+// returns false if there is no snapshot, no entry, or the entry is stale.
+// (the returned view stays valid until finish() is called.)
+bool find(std::string const &source, std::string_view *blob);
+
+//record state built from 'source' so that it can be written by finish():
+void store(std::string const &source, std::vector< char > &&blob);
+
+//------ helpers for building and reading relocatable blobs ------
+
+//a Range is an offset-based array "pointer" inside a blob:
+template< typename T >
+struct Range {
+	uint64_t offset = 0; //in bytes, from the start of the blob
+	uint64_t count = 0; //in elements
+};
+
+struct Writer {
+	std::vector< char > blob;
+
+	//append an array of (trivially copyable) values, aligned to 16 bytes:
+	template< typename T >
+	Range< T > append(T const *data, size_t count) {
+		static_assert(std::is_trivially_copyable< T >::value, "blob data must be trivially copyable");
+		Range< T > ret;
+		ret.offset = (blob.size() + 15) & ~uint64_t(15);
+		ret.count = count;
+		blob.resize(ret.offset + count * sizeof(T));
+		if (count) std::memcpy(blob.data() + ret.offset, data, count * sizeof(T));
+		return ret;
+	}
+	template< typename T >
+	Range< T > append(std::vector< T > const &data) {
+		return append(data.data(), data.size());
+	}
+
+	//reserve space for a header (always do this first, so header is at offset zero):
+	template< typename T >
+	void reserve_header() {
+		static_assert(std::is_trivially_copyable< T >::value, "blob headers must be trivially copyable");
+		blob.assign(sizeof(T), '\0');
+	}
+	template< typename T >
+	void set_header(T const &header) {
+		std::memcpy(blob.data(), &header, sizeof(T));
+	}
+};
+
+//look up the header at the start of a blob:
+// throws if the blob is too small.
+template< typename T >
+T const &header(std::string_view blob) {
+	if (blob.size() < sizeof(T)) {
+		throw std::runtime_error("Snapshot blob is too small to contain its header.");
+	}
+	return *reinterpret_cast< T const * >(blob.data());
+}
+
+//get a pointer to the start of a range:
+// throws if the range doesn't fit in the blob.
+template< typename T >
+T const *get(std::string_view blob, Range< T > const &range) {
+	if (range.offset % alignof(T) != 0
+	 || range.offset > blob.size()
+	 || range.count > (blob.size() - range.offset) / sizeof(T)) {
+		throw std::runtime_error("Snapshot blob contains an out-of-range array.");
+	}
+	return reinterpret_cast< T const * >(blob.data() + range.offset);
+}
+
+} //namespace Snapshot
@@ -1,10 +1,25 @@
 #include "Sound.hpp"
+#include "SoundEffects.hpp"
 #include "load_wav.hpp"
 #include "load_opus.hpp"
+#include "Snapshot.hpp"
+#include "HotReload.hpp"
+#include "MappedFile.hpp"
+#include "RealtimeCheck.hpp"
 
 #include <SDL3/SDL.h>
 
 #include <list>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <cassert>
 #include <exception>
 #include <iostream>
@@ -21,6 +36,237 @@ namespace {
 
 	//list of all currently playing samples:
 	std::list< std::shared_ptr< Sound::PlayingSample > > playing_samples;
+	//finished playing samples, moved here by the mixer (list splicing neither allocates nor frees)
+	// so that their last references are dropped by Sound::collect() rather than on the audio thread:
+	std::list< std::shared_ptr< Sound::PlayingSample > > finished_samples;
+
+	//per-bus mixing state:
+	constexpr float const DefaultDistanceCutoff = 2000.0f; //Hz
+	struct BusState {
+		Sound::Ramp< float > volume = Sound::Ramp< float >(1.0f);
+		std::vector< std::shared_ptr< Sound::Effect > > effects;
+		//filters the "far" part of 3D samples:
+		Sound::Biquad distance_filter = Sound::Biquad(Sound::Biquad::LowPass, DefaultDistanceCutoff);
+		bool far_active = false; //did anything go through distance_filter last block? (so its tail gets flushed)
+	};
+	BusState buses[Sound::BusCount];
+
+	//voice virtualization settings (see Sound::set_virtualization):
+	float virtual_threshold = 0.001f;
+	uint32_t max_voices = 64;
+	//(scratch space for picking the loudest voices; reserved in init() so the audio thread rarely allocates)
+	std::vector< float > audibilities;
+
+	//3D playing samples' positions and panning, structure-of-arrays in groups of PanLanes (see compute_pan_3D):
+	constexpr uint32_t const PanLanes = 8;
+	struct PanGroup {
+		float x[PanLanes], y[PanLanes], z[PanLanes], radius[PanLanes];
+		float left[PanLanes], right[PanLanes], far[PanLanes];
+	};
+	//(at start and end of the block; reserved in init() so the audio thread rarely allocates)
+	std::vector< PanGroup > pan_start, pan_end;
+	std::vector< Sound::PlayingSample * > pan_samples;
+
+	//playing samples quieter than this over a block are skipped (see Sound::set_silence_threshold):
+	float silence_threshold = 1.0e-4f;
+
+	//frames mixed so far (see Sound::clock()):
+	std::atomic< uint64_t > mix_clock(0);
+
+	//events scheduled with Sound::Batch, sorted by frame; the mixer applies them from 'next_event' on,
+	// but Batch::submit erases applied ones, so their references are dropped there rather than on the audio thread:
+	std::vector< Sound::Batch::Event > scheduled_events;
+	size_t next_event = 0;
+
+	//guards everything the mixer touches (see Sound::lock()):
+	std::recursive_mutex mix_mutex;
+
+	//interleaved stereo frame:
+	struct LR {
+		float l;
+		float r;
+	};
+	static_assert(sizeof(LR) == 8, "Sample is packed");
+
+	//each playing sample is resampled into 'mono' before being panned into its bus;
+	// buses have separate (planar) left/right channels for near sound and for far (to be low-passed) sound:
+	enum Channel : uint32_t { NearL, NearR, FarL, FarR, ChannelCount };
+	constexpr uint32_t const ScratchChannels = 1 + Sound::BusCount * ChannelCount; //(mono, then bus channels)
+	inline float *channel(float *scratch, uint32_t samples, uint32_t bus, Channel c) {
+		return scratch + samples * (1 + bus * ChannelCount + c);
+	}
+
+	//values shared by every playing sample mixed in a block:
+	struct MixBlock {
+		uint32_t samples = 0;
+		uint64_t start_frame = 0; //Sound::clock() at start of block
+		uint64_t end_frame = 0;
+		float cutoff = 0.0f; //playing samples less audible than this are virtual
+		float bus_gain[Sound::BusCount] = { }; //most each bus's output is scaled by this block (bus, master, and global volume)
+	} mix_block;
+
+	//scratch channels (laid out as above) that playing samples get mixed into:
+	struct MixTarget {
+		float *scratch = nullptr;
+		bool near_active[Sound::BusCount] = { };
+		bool far_active[Sound::BusCount] = { };
+		uint32_t virtual_voices = 0;
+		uint32_t silent_voices = 0;
+	};
+
+	//parallel voice mixing (see Sound::set_mix_threads):
+	// the mixing thread and each helper mix a contiguous range of 'mixing' into their own partition's
+	// channels, which are then summed in partition order -- so output doesn't depend on thread timing.
+	struct MixPool {
+		std::vector< std::thread > helpers; //helpers[i] mixes partition i+1
+		std::mutex mutex;
+		std::condition_variable start; //signalled when 'generation' changes (or 'quit' is set)
+		std::condition_variable done; //signalled when 'pending' reaches zero
+		uint64_t generation = 0;
+		uint32_t pending = 0; //helpers still mixing this generation
+		bool quit = false;
+	} mix_pool;
+	//only mix in parallel with at least this many playing samples per partition (else waking helpers costs more than it saves):
+	constexpr uint32_t const MinVoicesPerPartition = 8;
+	//playing samples being mixed this block, and per-partition channels (sized for MaxBlockFrames by set_mix_threads):
+	std::vector< Sound::PlayingSample * > mixing;
+	std::vector< std::vector< float > > partition_scratch;
+	std::vector< MixTarget > partition_targets;
+
+	//with mix threads, a feeder thread (instead of SDL's callback) renders blocks ahead of the device:
+	std::thread feeder;
+	std::atomic< bool > feeder_quit(false);
+
+	//output is always mixed in whole blocks of 'block_frames' frames (see Sound::set_latency),
+	// so ramp steps and per-mix cost don't depend on how much SDL happens to ask for at once:
+	constexpr uint32_t const MaxBlockFrames = 1024;
+	uint32_t block_frames = 256;
+	float latency_target = 0.02f; //seconds
+	uint32_t device_frames = 0; //frames per device buffer, as reported by SDL once the device is open
+	uint32_t ahead_frames = 0; //(with a feeder) keep this many frames queued in the stream
+	//scratch channels for mixing one block:
+	float mix_scratch[MaxBlockFrames * ScratchChannels];
+
+	//the most recently mixed block, handed to the device stream as SDL asks for it
+	// (SDL's stream queues whatever it is given, so a block-sized buffer is all the ring needed here):
+	struct OutputBlock {
+		float data[2 * MaxBlockFrames]; //interleaved stereo
+		uint32_t read = 0; //next frame to hand over
+		std::atomic< uint32_t > frames{0}; //frames not yet handed over (also read by Sound::latency())
+	} output_block;
+
+	//time spent mixing (read by Sound::mix_times()):
+	std::atomic< uint64_t > mix_callbacks(0);
+	std::atomic< uint64_t > mix_ns(0);
+	std::atomic< uint64_t > bus_ns(0);
+	std::atomic< uint64_t > mix_voices(0);
+	std::atomic< uint64_t > mix_virtual_voices(0);
+	std::atomic< uint64_t > mix_silent_voices(0);
+	std::atomic< uint64_t > mix_underruns(0);
+	std::atomic< uint64_t > mix_overruns(0);
+
+	//per-callback statistics, in a ring the mixer writes without locking (read by Sound::mix_stats()):
+	struct MixRecord {
+		int64_t start_ns = 0; //steady_clock time callback started
+		uint32_t duration_ns = 0;
+		uint32_t bus_ns = 0;
+		uint32_t frames = 0;
+		uint32_t voices = 0;
+		uint32_t virtual_voices = 0;
+		float peak = 0.0f;
+		bool underrun = false;
+		bool overrun = false;
+	};
+	struct MixRing {
+		static constexpr uint32_t const Size = 1024; //(about 10 seconds of callbacks at typical sizes)
+		//each slot is a seqlock: 'sequence' is odd while the record is being written:
+		struct Slot {
+			std::atomic< uint32_t > sequence{0};
+			MixRecord record;
+		} slots[Size];
+		std::atomic< uint64_t > written{0};
+
+		//called only from the mixer (which is never run by two threads at once):
+		void push(MixRecord const &record) {
+			uint64_t index = written.load(std::memory_order_relaxed);
+			Slot &slot = slots[index % Size];
+			uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+			slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.record = record;
+			slot.sequence.store(sequence + 2, std::memory_order_release);
+			written.store(index + 1, std::memory_order_release);
+		}
+		//read the record written 'index'-th; false if it's being (or has been) overwritten:
+		bool read(uint64_t index, MixRecord *record) const {
+			Slot const &slot = slots[index % Size];
+			uint32_t before = slot.sequence.load(std::memory_order_acquire);
+			if (before & 1) return false;
+			*record = slot.record;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return slot.sequence.load(std::memory_order_relaxed) == before;
+		}
+	} mix_ring;
+
+	//time when all audio mixed so far will have been played (used to detect underruns):
+	int64_t mixed_until_ns = 0;
+
+	//decoded sample cache (see Sound::set_cache_directory):
+	std::string cache_directory;
+	//bump this whenever the layout of cache files (or decoding) changes:
+	constexpr uint32_t const CacheVersion = 1;
+
+	//layout of cached sample data (a Snapshot-style blob, so Snapshot's helpers read and write it):
+	struct CacheHeader {
+		char magic[4] = {'s','n','d','c'};
+		uint32_t version = CacheVersion;
+		uint32_t rate = 0;
+		uint32_t encoding = 0;
+		Snapshot::Range< float > data;
+		Snapshot::Range< int16_t > pcm16;
+		Snapshot::Range< int8_t > block8;
+		Snapshot::Range< float > block8_scales;
+	};
+
+	//stats for Sound::load_times():
+	uint32_t samples_loaded = 0;
+	uint32_t samples_cached = 0;
+	double sample_load_seconds = 0.0;
+
+	//hash of file contents, used to name cache entries
+	// (processes 8 bytes at a time, so hashing a source file costs little more than mapping it):
+	uint64_t hash_contents(char const *data, size_t size) {
+		uint64_t hash = 0xcbf29ce484222325ull ^ uint64_t(size);
+		auto mix_in = [&hash](uint64_t word) {
+			hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+			hash ^= hash >> 32;
+		};
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			mix_in(word);
+		}
+		uint64_t tail = 0;
+		if (i < size) std::memcpy(&tail, data + i, size - i);
+		mix_in(tail);
+		return hash;
+	}
+
+	//path of the cache entry for 'source' decoded and stored as 'encoding' ("" if there's no cache or no source):
+	std::string cache_path(std::string const &source, Sound::Sample::Encoding encoding) {
+		if (cache_directory == "") return "";
+		uint64_t hash;
+		try {
+			MappedFile file(source);
+			hash = hash_contents(file.data, file.size);
+		} catch (std::exception &) {
+			return ""; //(decode will report the problem)
+		}
+		char name[64];
+		snprintf(name, sizeof(name), "%016llx-%u.sample", (unsigned long long)hash, uint32_t(encoding));
+		return (std::filesystem::path(cache_directory) / name).string();
+	}
 
 }
 
@@ -34,80 +280,452 @@ Sound::Listener Sound::listener;
 
 //This audio-mixing callback is defined below:
 void mix_audio(void *, SDL_AudioStream *stream, int additional_amount, int total_amount);
+//...as is the mixer it uses:
+void mix(float *out, uint32_t samples);
+//...the loop run by mix threads' helpers:
+void mix_helper(uint32_t partition, uint64_t generation);
+//...and the loop that feeds the device when mixing ahead:
+void feed_audio();
 
 //------------------------ public-facing --------------------------------
 
-Sound::Sample::Sample(std::string const &filename) {
+Sound::Sample::Sample(std::string const &filename, Encoding encoding_) {
+	//layout of decoded data in a startup snapshot:
+	struct SnapshotHeader {
+		Snapshot::Range< float > data;
+		uint32_t rate;
+		uint32_t padding = 0;
+	};
+
+	auto before = std::chrono::high_resolution_clock::now();
+
+	std::string_view blob;
+	std::string cached;
+	if (Snapshot::find(filename, &blob)) {
+		SnapshotHeader const &header = Snapshot::header< SnapshotHeader >(blob);
+		float const *begin = Snapshot::get(blob, header.data);
+		data.assign(begin, begin + header.data.count);
+		rate = header.rate;
+		encode(encoding_);
+	} else if (!Snapshot::active() && (cached = cache_path(filename, encoding_)) != "" && read_cache(cached)) {
+		//(read_cache filled in the data)
+		samples_cached += 1;
+	} else {
+		decode(filename, &data, &rate);
+
+		if (Snapshot::active()) { //record decoded data for later runs:
+			Snapshot::Writer writer;
+			writer.reserve_header< SnapshotHeader >();
+			SnapshotHeader header;
+			header.data = writer.append(data);
+			header.rate = rate;
+			writer.set_header(header);
+			Snapshot::store(filename, std::move(writer.blob));
+		}
+
+		encode(encoding_);
+
+		if (cached != "") write_cache(cached);
+	}
+	update_envelope();
+
+	samples_loaded += 1;
+	sample_load_seconds += std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count();
+
+	//swap in new data when the file changes:
+	HotReload::watch(filename, this, [this,filename](){
+		reload(filename);
+	});
+}
+
+Sound::Sample::Sample(std::vector< float > const &data_, uint32_t rate_, Encoding encoding_) : data(data_), rate(rate_) {
+	//(the mixer wraps looping samples at their end, so it needs at least one value)
+	if (data.empty()) {
+		throw std::runtime_error("Sample data is empty.");
+	}
+	encode(encoding_);
+	update_envelope();
+}
+
+Sound::Sample::~Sample() {
+	HotReload::unwatch(this);
+}
+
+bool Sound::Sample::read_cache(std::string const &path) {
+	if (!std::filesystem::exists(path)) return false;
+	try {
+		MappedFile file(path);
+		std::string_view blob(file.data, file.size);
+		CacheHeader const &header = Snapshot::header< CacheHeader >(blob);
+		if (std::string(header.magic, 4) != "sndc" || header.version != CacheVersion || header.encoding > uint32_t(Encoding::Block8)) {
+			return false;
+		}
+		//the array for the entry's encoding must be non-empty (with one scale per Block8 block), and the others empty:
+		// (otherwise the mixer would read out of bounds; decode instead)
+		Encoding cached_encoding = Encoding(header.encoding);
+		bool counts_ok = (header.rate != 0);
+		if (cached_encoding == Encoding::Float) {
+			counts_ok = counts_ok && header.data.count != 0 && header.pcm16.count == 0 && header.block8.count == 0 && header.block8_scales.count == 0;
+		} else if (cached_encoding == Encoding::PCM16) {
+			counts_ok = counts_ok && header.data.count == 0 && header.pcm16.count != 0 && header.block8.count == 0 && header.block8_scales.count == 0;
+		} else { assert(cached_encoding == Encoding::Block8);
+			counts_ok = counts_ok && header.data.count == 0 && header.pcm16.count == 0 && header.block8.count != 0
+				&& header.block8_scales.count == (header.block8.count + Block8Size - 1) / Block8Size;
+		}
+		if (!counts_ok) {
+			std::cerr << "WARNING: ignoring audio cache file '" << path << "': array sizes don't match its encoding." << std::endl;
+			return false;
+		}
+		auto assign = [&blob](auto const &range, auto *vec) {
+			auto const *begin = Snapshot::get(blob, range);
+			vec->assign(begin, begin + range.count);
+		};
+		assign(header.data, &data);
+		assign(header.pcm16, &pcm16);
+		assign(header.block8, &block8);
+		assign(header.block8_scales, &block8_scales);
+		rate = header.rate;
+		encoding = cached_encoding;
+	} catch (std::exception &e) {
+		std::cerr << "WARNING: ignoring audio cache file '" << path << "': " << e.what() << std::endl;
+		data.clear(); pcm16.clear(); block8.clear(); block8_scales.clear();
+		encoding = Encoding::Float;
+		return false;
+	}
+	return true;
+}
+
+void Sound::Sample::write_cache(std::string const &path) const {
+	Snapshot::Writer writer;
+	writer.reserve_header< CacheHeader >();
+	CacheHeader header;
+	header.rate = rate;
+	header.encoding = uint32_t(encoding);
+	header.data = writer.append(data);
+	header.pcm16 = writer.append(pcm16);
+	header.block8 = writer.append(block8);
+	header.block8_scales = writer.append(block8_scales);
+	writer.set_header(header);
+
+	//write to a temporary file and rename, so a partly-written entry is never read:
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary);
+		out.write(writer.blob.data(), writer.blob.size());
+		if (!out) {
+			std::cerr << "WARNING: failed to write audio cache file '" << temp << "'." << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(temp, path, ec);
+	if (ec) {
+		std::cerr << "WARNING: failed to rename audio cache file to '" << path << "': " << ec.message() << std::endl;
+		std::filesystem::remove(temp, ec);
+	}
+}
+
+void Sound::set_cache_directory(std::string const &path) {
+	cache_directory = path;
+}
+
+Sound::LoadTimes Sound::load_times() {
+	LoadTimes times;
+	times.samples = samples_loaded;
+	times.cached = samples_cached;
+	times.seconds = sample_load_seconds;
+	return times;
+}
+
+uint32_t Sound::Sample::size() const {
+	if (encoding == Encoding::PCM16) return uint32_t(pcm16.size());
+	else if (encoding == Encoding::Block8) return uint32_t(block8.size());
+	else return uint32_t(data.size());
+}
+
+size_t Sound::Sample::memory() const {
+	return data.capacity() * sizeof(float)
+	     + pcm16.capacity() * sizeof(int16_t)
+	     + block8.capacity() * sizeof(int8_t)
+	     + block8_scales.capacity() * sizeof(float);
+}
+
+float Sound::Sample::at(uint32_t i) const {
+	if (encoding == Encoding::PCM16) return pcm16[i] * (1.0f / 32767.0f);
+	else if (encoding == Encoding::Block8) return block8[i] * block8_scales[i / Block8Size];
+	else return data[i];
+}
+
+void Sound::Sample::encode(Encoding new_encoding) {
+	if (new_encoding == encoding) return;
+	if (encoding != Encoding::Float) {
+		throw std::runtime_error("Can only re-encode samples stored as Float.");
+	}
+
+	if (new_encoding == Encoding::PCM16) {
+		pcm16.resize(data.size());
+		for (size_t i = 0; i < data.size(); ++i) {
+			pcm16[i] = int16_t(std::lround(std::max(-1.0f, std::min(1.0f, data[i])) * 32767.0f));
+		}
+	} else if (new_encoding == Encoding::Block8) {
+		block8.resize(data.size());
+		block8_scales.resize((data.size() + Block8Size - 1) / Block8Size);
+		for (size_t b = 0; b < block8_scales.size(); ++b) {
+			size_t begin = b * Block8Size;
+			size_t end = std::min(begin + Block8Size, data.size());
+			float peak = 0.0f;
+			for (size_t i = begin; i < end; ++i) {
+				peak = std::max(peak, std::abs(data[i]));
+			}
+			block8_scales[b] = peak / 127.0f;
+			float inv_scale = (peak > 0.0f ? 127.0f / peak : 0.0f);
+			for (size_t i = begin; i < end; ++i) {
+				block8[i] = int8_t(std::lround(data[i] * inv_scale));
+			}
+		}
+	} else {
+		throw std::runtime_error("Unknown sample encoding.");
+	}
+
+	encoding = new_encoding;
+	data.clear();
+	data.shrink_to_fit();
+}
+
+void Sound::Sample::update_envelope() {
+	uint32_t count = size();
+	envelope.assign((count + EnvelopeSize - 1) / EnvelopeSize, 0.0f);
+	for (uint32_t i = 0; i < count; ++i) {
+		float &peak = envelope[i / EnvelopeSize];
+		peak = std::max(peak, std::abs(at(i)));
+	}
+}
+
+void Sound::Sample::decode(std::string const &filename, std::vector< float > *data_, uint32_t *rate_) {
+	assert(rate_);
 	if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".wav") {
-		load_wav(filename, &data);
+		load_wav(filename, data_, rate_);
 	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".opus") {
-		load_opus(filename, &data);
+		load_opus(filename, data_);
+		*rate_ = 48000; //(opus always decodes at 48kHz)
 	} else {
 		throw std::runtime_error("Sample '" + filename + "' doesn't end in either \".wav\" or \".opus\" -- unsure how to load.");
 	}
+	if (data_->empty()) {
+		throw std::runtime_error("Sample '" + filename + "' decoded to no audio.");
+	}
 }
 
-Sound::Sample::Sample(std::vector< float > const &data_) : data(data_) {
+void Sound::Sample::reload(std::string const &filename) {
+	//decode outside the lock so the audio callback isn't held up:
+	std::vector< float > new_data;
+	uint32_t new_rate = 0;
+	decode(filename, &new_data, &new_rate); //(throws on empty data, too)
+	//...and encode the same way as the current data:
+	Sample fresh(new_data, new_rate, encoding);
+	new_data.clear();
+
+	Sound::lock();
+	data.swap(fresh.data);
+	pcm16.swap(fresh.pcm16);
+	block8.swap(fresh.block8);
+	block8_scales.swap(fresh.block8_scales);
+	envelope.swap(fresh.envelope);
+	rate = new_rate;
+	//playing copies of this sample reference it, so just fix up any that are now past the end:
+	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
+		PlayingSample &playing_sample = **si;
+		if (&playing_sample.sample == this && playing_sample.i >= size()) {
+			if (playing_sample.loop) {
+				playing_sample.i = 0;
+				playing_sample.t = 0.0f;
+			} else {
+				playing_sample.stopped = true;
+				si = playing_samples.erase(si);
+				continue;
+			}
+		}
+		++si;
+	}
+	Sound::unlock();
+	//(old data is freed here, outside the lock)
 }
 
 
 
-void Sound::init() {
+void Sound::init(uint32_t mix_threads) {
+	set_mix_threads(mix_threads);
+
 	if (!SDL_InitSubSystem(SDL_INIT_AUDIO)) {
 		std::cerr << "Failed to initialize SDL audio subsytem:\n" << SDL_GetError() << std::endl;
 		std::cerr << "  (Will continue without audio.)\n" << std::endl;
 		return;
 	}
 
+	audibilities.reserve(1024);
+	mixing.reserve(1024);
+	pan_samples.reserve(1024);
+	pan_start.reserve(1024 / PanLanes);
+	pan_end.reserve(1024 / PanLanes);
+
 	//Based on the example on https://wiki.libsdl.org/SDL_OpenAudioDevice
 	SDL_AudioSpec spec{ .format=SDL_AUDIO_F32, .channels=2, .freq=AUDIO_RATE };
-	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, mix_audio, nullptr);
+	//with mix threads, render ahead from a feeder thread, so SDL's device thread never waits on a mix:
+	bool mix_ahead = (mix_threads > 1);
+
+	//ask for a device buffer that (along with anything queued ahead of it) meets the latency target:
+	uint32_t target_frames = std::max(block_frames, uint32_t(std::round(latency_target * AUDIO_RATE)));
+	uint32_t device_request = (mix_ahead ? std::max(block_frames, target_frames / 2) : target_frames);
+	SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, std::to_string(device_request).c_str());
+
+	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, (mix_ahead ? nullptr : mix_audio), nullptr);
 	if (stream == nullptr) {
 		std::cerr << "Failed to open audio device:\n" << SDL_GetError() << std::endl;
 		std::cerr << "  (Will continue without audio.)\n" << std::endl;
 	} else {
+		//the device may not have granted the requested buffer size:
+		SDL_AudioSpec device_spec;
+		int sample_frames = 0;
+		if (SDL_GetAudioDeviceFormat(SDL_GetAudioStreamDevice(stream), &device_spec, &sample_frames) && sample_frames > 0) {
+			device_frames = uint32_t(sample_frames);
+		} else {
+			device_frames = device_request;
+		}
+
+		if (mix_ahead) {
+			ahead_frames = std::max(block_frames, (target_frames > device_frames ? target_frames - device_frames : 0));
+			feeder_quit = false;
+			feeder = std::thread(feed_audio);
+		}
 		//start audio playback:
 		SDL_ResumeAudioStreamDevice(stream);
-		std::cout << "Audio output initialized." << std::endl;
+		Latency info = latency();
+		std::cout << "Audio output initialized (" << block_frames << "-frame blocks, " << device_frames << "-frame device buffer, about " << info.total * 1000.0f << " ms latency";
+		if (mix_threads > 1) std::cout << ", mixing with " << mix_threads << " threads";
+		std::cout << ")." << std::endl;
 	}
 }
 
 
 void Sound::shutdown() {
+	if (feeder.joinable()) {
+		feeder_quit = true;
+		feeder.join();
+	}
 	if (stream != nullptr) {
 		//stop audio playback:
 		SDL_DestroyAudioStream(stream);
 		stream = nullptr;
 	}
+	set_mix_threads(1); //(stops helpers)
+	collect();
+}
+
+void Sound::collect() {
+	std::list< std::shared_ptr< Sound::PlayingSample > > finished;
+	lock();
+	finished.splice(finished.end(), finished_samples);
+	unlock();
+	//(finished playing samples are freed here, outside the lock)
+}
+
+void Sound::set_mix_threads(uint32_t threads) {
+	threads = std::max(1u, threads);
+
+	lock();
+	if (mix_pool.helpers.size() + 1 != threads) {
+		//stop old helpers (they are idle, since the mixer can't be running):
+		{
+			std::lock_guard< std::mutex > pool_lock(mix_pool.mutex);
+			mix_pool.quit = true;
+		}
+		mix_pool.start.notify_all();
+		for (auto &helper : mix_pool.helpers) {
+			helper.join();
+		}
+		mix_pool.helpers.clear();
+		mix_pool.quit = false;
+
+		partition_scratch.resize(threads);
+		partition_targets.resize(threads);
+		for (uint32_t partition = 0; partition < threads; ++partition) {
+			partition_scratch[partition].resize(MaxBlockFrames * ScratchChannels);
+			partition_targets[partition].scratch = partition_scratch[partition].data();
+		}
+		//helpers start from the current generation (read here, since mix() may bump it before they run):
+		uint64_t generation;
+		{
+			std::lock_guard< std::mutex > pool_lock(mix_pool.mutex);
+			generation = mix_pool.generation;
+		}
+		for (uint32_t partition = 1; partition < threads; ++partition) {
+			mix_pool.helpers.emplace_back(mix_helper, partition, generation);
+		}
+	}
+	unlock();
+}
+
+void Sound::set_silence_threshold(float threshold) {
+	lock();
+	silence_threshold = std::max(0.0f, threshold);
+	unlock();
 }
 
+void Sound::set_latency(float seconds, uint32_t block_frames_) {
+	lock();
+	latency_target = std::max(0.0f, seconds);
+	block_frames = std::clamp(block_frames_, 32u, MaxBlockFrames);
+	unlock();
+}
+
+Sound::Latency Sound::latency() {
+	Latency ret;
+	ret.target = latency_target;
+	ret.block_frames = block_frames;
+	if (stream) {
+		ret.device_frames = device_frames;
+		uint32_t queued = uint32_t(std::max(0, SDL_GetAudioStreamQueued(stream))) / (2 * sizeof(float)) + output_block.frames;
+		ret.queued = queued / float(AUDIO_RATE);
+		ret.total = (device_frames + queued) / float(AUDIO_RATE);
+	}
+	return ret;
+}
 
 void Sound::lock() {
-	if (stream) SDL_LockAudioStream(stream);
+	//real-time code shouldn't wait on other threads, so report when this lock would actually block there:
+	// (where RealtimeCheck replaces pthread_mutex_lock, it already does this for every lock)
+	#ifndef REALTIME_CHECK_LIBC
+	if (RealtimeCheck::active()) {
+		if (mix_mutex.try_lock()) return;
+		RealtimeCheck::check(RealtimeCheck::Kind::Block, "Sound::lock waited");
+	}
+	#endif
+	mix_mutex.lock();
 }
 
 void Sound::unlock() {
-	if (stream) SDL_UnlockAudioStream(stream);
+	mix_mutex.unlock();
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const &sample, float play_volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, false);
+std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const &sample, float play_volume, float pan, float rate) {
+	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, false, rate);
 	lock();
 	playing_samples.emplace_back(playing_sample);
 	unlock();
 	return playing_sample;
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, false);
+std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, float rate) {
+	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, false, rate);
 	lock();
 	playing_samples.emplace_back(playing_sample);
 	unlock();
 	return playing_sample;
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float play_volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, true);
+std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float play_volume, float pan, float rate) {
+	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, true, rate);
 	lock();
 	playing_samples.emplace_back(playing_sample);
 	unlock();
@@ -116,14 +734,88 @@ std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float
 
 
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, true);
+std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, float rate) {
+	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, true, rate);
 	lock();
 	playing_samples.emplace_back(playing_sample);
 	unlock();
 	return playing_sample;
 }
 
+uint64_t Sound::clock() {
+	return mix_clock.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::Batch::play(uint64_t at, Sample const &sample, float play_volume, float pan, float rate) {
+	starts.emplace_back(std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, false, rate));
+	starts.back()->start = at;
+	return starts.back();
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::Batch::play_3D(uint64_t at, Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, float rate) {
+	starts.emplace_back(std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, false, rate));
+	starts.back()->start = at;
+	return starts.back();
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::Batch::loop(uint64_t at, Sample const &sample, float play_volume, float pan, float rate) {
+	starts.emplace_back(std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, true, rate));
+	starts.back()->start = at;
+	return starts.back();
+}
+
+std::shared_ptr< Sound::PlayingSample > Sound::Batch::loop_3D(uint64_t at, Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius, float rate) {
+	starts.emplace_back(std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, true, rate));
+	starts.back()->start = at;
+	return starts.back();
+}
+
+void Sound::Batch::stop(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float ramp) {
+	events.emplace_back(Event{at, Event::Stop, playing_sample, glm::vec3(0.0f), ramp});
+}
+
+void Sound::Batch::set_volume(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_volume, float ramp) {
+	events.emplace_back(Event{at, Event::Volume, playing_sample, glm::vec3(new_volume, 0.0f, 0.0f), ramp});
+}
+
+void Sound::Batch::set_pan(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_pan, float ramp) {
+	events.emplace_back(Event{at, Event::Pan, playing_sample, glm::vec3(new_pan, 0.0f, 0.0f), ramp});
+}
+
+void Sound::Batch::set_position(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, glm::vec3 const &new_position, float ramp) {
+	events.emplace_back(Event{at, Event::Position, playing_sample, new_position, ramp});
+}
+
+void Sound::Batch::set_rate(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_rate, float ramp) {
+	events.emplace_back(Event{at, Event::Rate, playing_sample, glm::vec3(new_rate, 0.0f, 0.0f), ramp});
+}
+
+void Sound::Batch::submit() {
+	auto earlier = [](Event const &a, Event const &b) { return a.at < b.at; };
+	std::stable_sort(events.begin(), events.end(), earlier);
+
+	std::vector< Event > applied;
+
+	lock();
+	for (auto &playing_sample : starts) {
+		playing_samples.emplace_back(std::move(playing_sample));
+	}
+	if (!events.empty() || next_event > 0) {
+		applied.assign(std::make_move_iterator(scheduled_events.begin()), std::make_move_iterator(scheduled_events.begin() + next_event));
+		scheduled_events.erase(scheduled_events.begin(), scheduled_events.begin() + next_event);
+		next_event = 0;
+
+		size_t middle = scheduled_events.size();
+		scheduled_events.insert(scheduled_events.end(), std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()));
+		std::inplace_merge(scheduled_events.begin(), scheduled_events.begin() + middle, scheduled_events.end(), earlier);
+	}
+	unlock();
+
+	starts.clear();
+	events.clear();
+	//(applied events -- possibly holding the last references to finished samples -- are freed here, outside the lock)
+}
+
 
 void Sound::stop_all_samples() {
 	lock();
@@ -139,6 +831,102 @@ void Sound::set_volume(float new_volume, float ramp) {
 	unlock();
 }
 
+void Sound::set_bus_volume(Bus bus, float new_volume, float ramp) {
+	lock();
+	buses[uint32_t(bus)].volume.set(new_volume, ramp);
+	unlock();
+}
+
+void Sound::set_bus_effects(Bus bus, std::vector< std::shared_ptr< Effect > > const &effects) {
+	std::vector< std::shared_ptr< Effect > > new_effects = effects;
+	lock();
+	buses[uint32_t(bus)].effects.swap(new_effects);
+	unlock();
+	//(old effects are freed here, outside the lock)
+}
+
+void Sound::set_distance_lowpass(float frequency) {
+	Biquad filter(Biquad::LowPass, frequency);
+	lock();
+	for (auto &bus : buses) {
+		//keep filter state so there's no click:
+		bus.distance_filter.b0 = filter.b0;
+		bus.distance_filter.b1 = filter.b1;
+		bus.distance_filter.b2 = filter.b2;
+		bus.distance_filter.a1 = filter.a1;
+		bus.distance_filter.a2 = filter.a2;
+	}
+	unlock();
+}
+
+void Sound::set_virtualization(float threshold, uint32_t max_voices_) {
+	lock();
+	virtual_threshold = threshold;
+	max_voices = max_voices_;
+	unlock();
+}
+
+Sound::MixTimes Sound::mix_times() {
+	MixTimes times;
+	times.callbacks = mix_callbacks.load(std::memory_order_relaxed);
+	times.mix_seconds = mix_ns.load(std::memory_order_relaxed) * 1.0e-9;
+	times.bus_seconds = bus_ns.load(std::memory_order_relaxed) * 1.0e-9;
+	times.voices = mix_voices.load(std::memory_order_relaxed);
+	times.virtual_voices = mix_virtual_voices.load(std::memory_order_relaxed);
+	times.silent_voices = mix_silent_voices.load(std::memory_order_relaxed);
+	times.underruns = mix_underruns.load(std::memory_order_relaxed);
+	times.overruns = mix_overruns.load(std::memory_order_relaxed);
+	return times;
+}
+
+Sound::MixStats Sound::mix_stats(float seconds) {
+	MixStats stats;
+	int64_t now = std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t since = now - int64_t(seconds * 1.0e9f);
+
+	double duration_total = 0.0, load_total = 0.0, voices_total = 0.0, virtual_total = 0.0;
+	int64_t earliest = now;
+	uint64_t written = mix_ring.written.load(std::memory_order_acquire);
+	uint64_t oldest = (written > MixRing::Size ? written - MixRing::Size : 0);
+	//newest to oldest, stopping at the window start or at a record the mixer is overwriting:
+	for (uint64_t index = written; index > oldest; --index) {
+		MixRecord record;
+		if (!mix_ring.read(index - 1, &record)) break;
+		if (record.start_ns < since) break;
+
+		float duration_us = record.duration_ns * 1.0e-3f;
+		float load = record.duration_ns / (record.frames * 1.0e9f / AUDIO_RATE);
+		if (stats.callbacks == 0) {
+			stats.frames_min = stats.frames_max = record.frames;
+		}
+		stats.callbacks += 1;
+		duration_total += duration_us;
+		stats.duration_max_us = std::max(stats.duration_max_us, duration_us);
+		stats.bus_max_us = std::max(stats.bus_max_us, record.bus_ns * 1.0e-3f);
+		load_total += load;
+		stats.load_max = std::max(stats.load_max, load);
+		stats.frames_min = std::min(stats.frames_min, record.frames);
+		stats.frames_max = std::max(stats.frames_max, record.frames);
+		voices_total += record.voices;
+		virtual_total += record.virtual_voices;
+		stats.voices_max = std::max(stats.voices_max, record.voices);
+		stats.virtual_max = std::max(stats.virtual_max, record.virtual_voices);
+		stats.peak = std::max(stats.peak, record.peak);
+		if (record.underrun) stats.underruns += 1;
+		if (record.overrun) stats.overruns += 1;
+		earliest = record.start_ns;
+	}
+
+	if (stats.callbacks) {
+		stats.seconds = (now - earliest) * 1.0e-9f;
+		stats.duration_avg_us = float(duration_total / stats.callbacks);
+		stats.load_avg = float(load_total / stats.callbacks);
+		stats.voices_avg = float(voices_total / stats.callbacks);
+		stats.virtual_avg = float(virtual_total / stats.callbacks);
+	}
+	return stats;
+}
+
 //------------------
 
 void Sound::PlayingSample::set_volume(float new_volume, float ramp) {
@@ -170,6 +958,18 @@ void Sound::PlayingSample::set_half_volume_radius(float new_radius, float ramp)
 	Sound::unlock();
 }
 
+void Sound::PlayingSample::set_rate(float new_rate, float ramp) {
+	Sound::lock();
+	rate.set(std::max(0.0f, new_rate), ramp);
+	Sound::unlock();
+}
+
+void Sound::PlayingSample::set_bus(Bus new_bus) {
+	Sound::lock();
+	bus = new_bus;
+	Sound::unlock();
+}
+
 void Sound::PlayingSample::stop(float ramp) {
 	Sound::lock();
 	if (!(stopping || stopped)) {
@@ -210,35 +1010,53 @@ inline void compute_pan_weights(float pan, float *left, float *right) {
 	*right = std::sin(ang);
 }
 
-//helper: 3D audio panning
-void compute_pan_from_listener_and_position(
-	glm::vec3 const &listener_position,
-	glm::vec3 const &listener_right,
-	glm::vec3 const &source_position,
-	float source_half_radius,
-	float *left, float *right
-	) {
-	glm::vec3 to = source_position - listener_position;
-	float distance = glm::length(to);
-	//start by panning based on direction.
-	//note that for a LR fade to sound uniform, sound power (squared magnitude) should remain constant.
-	if (distance == 0.0f) {
-		*left = *right = std::sqrt(2.0f);
-	} else {
+//helper: 3D audio panning for a group of sources (positions and half-volume radii are in 'group')
+// written as one branch-free loop over fixed-size arrays so that it compiles to SIMD code:
+// std::sqrt and std::cos/sin are replaced by a refined reciprocal square root and short polynomials
+// (gains within about 5e-5 of exact -- far below anything audible):
+void compute_pan_3D(glm::vec3 const &listener_position, glm::vec3 const &listener_right, PanGroup &group) {
+	for (uint32_t i = 0; i < PanLanes; ++i) {
+		float dx = group.x[i] - listener_position.x;
+		float dy = group.y[i] - listener_position.y;
+		float dz = group.z[i] - listener_position.z;
+		float distance2 = dx * dx + dy * dy + dz * dz;
+
+		//1 / distance (bit-trick estimate, then two Newton steps; stays finite when distance2 == 0):
+		uint32_t bits;
+		std::memcpy(&bits, &distance2, sizeof(bits));
+		bits = 0x5f375a86u - (bits >> 1);
+		float inv_distance;
+		std::memcpy(&inv_distance, &bits, sizeof(inv_distance));
+		inv_distance *= 1.5f - 0.5f * distance2 * inv_distance * inv_distance;
+		inv_distance *= 1.5f - 0.5f * distance2 * inv_distance * inv_distance;
+		float distance = distance2 * inv_distance;
+
+		//start by panning based on direction.
+		//note that for a LR fade to sound uniform, sound power (squared magnitude) should remain constant.
 		//amt ranges from -1 (most left) to 1 (most right):
-		float amt = glm::dot(listener_right, to) / distance;
-		//turn into an angle from 0.0f (most left) to pi/2 (most right):
-		float ang = 0.5f * 3.1415926f * (0.5f * (amt + 1.0f));
-		*left = std::cos(ang);
-		*right = std::sin(ang);
+		float amt = (listener_right.x * dx + listener_right.y * dy + listener_right.z * dz) * inv_distance;
+		//turn into an angle 'a' from -pi/4 (most left) to pi/4 (most right), so left = cos(pi/4 + a), right = sin(pi/4 + a):
+		float a = 0.25f * 3.1415926f * amt;
+		float a2 = a * a;
+		float sin_a = a * (1.0f + a2 * (-1.0f / 6.0f + a2 * (1.0f / 120.0f)));
+		float cos_a = 1.0f + a2 * (-0.5f + a2 * (1.0f / 24.0f + a2 * (-1.0f / 720.0f)));
+		float left = 0.70710678f * (cos_a - sin_a);
+		float right = 0.70710678f * (cos_a + sin_a);
+		//(a source exactly at the listener plays at sqrt(2) in both ears:)
+		float centered = float(distance2 == 0.0f);
+		left += centered * 0.70710678f;
+		right += centered * 0.70710678f;
 
 		//squared distance attenuation is realistic if there are no walls,
 		// but I'm going to use linear because it's sounds better to me.
 		// (feel free to change it, of course)
 		//want att = 0.5f at distance == half_volume_radius
-		float att = 1.0f / (1.0f + (distance / source_half_radius));
-		*left *= att;
-		*right *= att;
+		float att = 1.0f / (1.0f + (distance / group.radius[i]));
+		group.left[i] = att * left;
+		group.right[i] = att * right;
+
+		//the quieter the sound is from distance, the more of it is low-passed:
+		group.far[i] = 1.0f - att;
 	}
 }
 
@@ -299,32 +1117,418 @@ void step_direction_ramp(float step, Sound::Ramp< glm::vec3 > &ramp) {
 	}
 }
 
+//helpers: read sample data in each encoding, one value at a time ([]) or converting a range to float (copy):
+// (the copy loops vectorize)
+struct FloatSource {
+	float const *data;
+	float operator[](uint32_t j) const { return data[j]; }
+	void copy(uint32_t begin, uint32_t count, float *out) const {
+		std::copy(data + begin, data + begin + count, out);
+	}
+};
+
+struct PCM16Source {
+	int16_t const *data;
+	float operator[](uint32_t j) const { return data[j] * (1.0f / 32767.0f); }
+	void copy(uint32_t begin, uint32_t count, float *out) const {
+		int16_t const *in = data + begin;
+		for (uint32_t k = 0; k < count; ++k) {
+			out[k] = in[k] * (1.0f / 32767.0f);
+		}
+	}
+};
+
+struct Block8Source {
+	int8_t const *data;
+	float const *scales;
+	float operator[](uint32_t j) const { return data[j] * scales[j / Sound::Sample::Block8Size]; }
+	void copy(uint32_t begin, uint32_t count, float *out) const {
+		//in runs that share a scale:
+		uint32_t end = begin + count;
+		while (begin < end) {
+			uint32_t run_end = std::min(end, (begin / Sound::Sample::Block8Size + 1) * Sound::Sample::Block8Size);
+			float scale = scales[begin / Sound::Sample::Block8Size];
+			int8_t const *in = data + begin;
+			for (uint32_t k = 0; k < run_end - begin; ++k) {
+				out[k] = in[k] * scale;
+			}
+			out += run_end - begin;
+			begin = run_end;
+		}
+	}
+};
+
+//helper: read 'count' output samples of a playing sample into 'out', stepping through its data
+// by 'start_step' (ramping linearly to 'end_step') data values per output sample.
+// returns the number of samples written (fewer than 'count' if a non-looping sample runs out):
+template< typename Source >
+uint32_t resample(Sound::PlayingSample &playing_sample, Source const &data, float start_step, float end_step, uint32_t count, float *out) {
+	uint32_t size = playing_sample.sample.size();
+	uint32_t &i = playing_sample.i;
+	float &t = playing_sample.t;
+
+	//playing at the data's own rate is just a copy:
+	if (start_step == 1.0f && end_step == 1.0f && t == 0.0f) {
+		uint32_t s = 0;
+		while (s < count) {
+			uint32_t n = std::min(count - s, size - i);
+			data.copy(i, n, out + s);
+			s += n;
+			i += n;
+			if (i == size) {
+				if (!playing_sample.loop) break;
+				i = 0;
+			}
+		}
+		return s;
+	}
+
+	//otherwise, Catmull-Rom interpolate between data[i] and data[i+1] using data[i-1] and data[i+2] too.
+	//neighbors past the ends wrap when looping and are silent otherwise:
+	auto at = [&](int64_t j) -> float {
+		if (j < 0) return (playing_sample.loop ? data[size - 1] : 0.0f);
+		if (j >= int64_t(size)) return (playing_sample.loop ? data[uint32_t(j - size) % size] : 0.0f);
+		return data[uint32_t(j)];
+	};
+
+	//work in blocks: first find neighbors (scalar: read positions depend on the running step),
+	// then evaluate the cubics in a straight loop the compiler can vectorize:
+	constexpr uint32_t const Block = 64;
+	float y0[Block], y1[Block], y2[Block], y3[Block], frac[Block];
+
+	float step = start_step;
+	float step_step = (end_step - start_step) / count;
+	uint32_t s = 0;
+	bool finished = false;
+	while (s < count && !finished) {
+		uint32_t n = 0;
+		while (n < Block && s + n < count) {
+			if (i >= 1 && i + 2 < size) {
+				y0[n] = data[i-1]; y1[n] = data[i]; y2[n] = data[i+1]; y3[n] = data[i+2];
+			} else {
+				y0[n] = at(int64_t(i)-1); y1[n] = at(i); y2[n] = at(int64_t(i)+1); y3[n] = at(int64_t(i)+2);
+			}
+			frac[n] = t;
+			n += 1;
+
+			//advance read position:
+			t += step;
+			step += step_step;
+			uint32_t whole = uint32_t(t);
+			t -= float(whole);
+			i += whole;
+			if (i >= size) {
+				if (!playing_sample.loop) {
+					finished = true;
+					break;
+				}
+				i %= size;
+			}
+		}
+
+		for (uint32_t k = 0; k < n; ++k) {
+			float a = y0[k], b = y1[k], c = y2[k], d = y3[k], x = frac[k];
+			out[s + k] = b + 0.5f * x * (c - a + x * (2.0f * a - 5.0f * b + 4.0f * c - d + x * (3.0f * (b - c) + d - a)));
+		}
+		s += n;
+	}
+	return s;
+}
+
+//...decoding whichever encoding the sample uses:
+uint32_t resample(Sound::PlayingSample &playing_sample, float start_step, float end_step, uint32_t count, float *out) {
+	Sound::Sample const &sample = playing_sample.sample;
+	if (sample.encoding == Sound::Sample::Encoding::PCM16) {
+		return resample(playing_sample, PCM16Source{ sample.pcm16.data() }, start_step, end_step, count, out);
+	} else if (sample.encoding == Sound::Sample::Encoding::Block8) {
+		return resample(playing_sample, Block8Source{ sample.block8.data(), sample.block8_scales.data() }, start_step, end_step, count, out);
+	} else {
+		return resample(playing_sample, FloatSource{ sample.data.data() }, start_step, end_step, count, out);
+	}
+}
+
+//helper: move a playing sample's read position as far as resample() would have, without reading data:
+// (used for virtual samples)
+void advance(Sound::PlayingSample &playing_sample, float start_step, float end_step, uint32_t count) {
+	uint32_t size = playing_sample.sample.size();
+	//sum of count steps ramping from start_step toward end_step (as in resample):
+	double distance = double(count) * start_step + 0.5 * double(end_step - start_step) * double(count - 1);
+	double position = double(playing_sample.t) + std::max(0.0, distance);
+	double whole = std::floor(position);
+	playing_sample.t = float(position - whole);
+	uint64_t i = uint64_t(playing_sample.i) + uint64_t(whole);
+	if (i >= size) {
+		if (playing_sample.loop) {
+			i %= size;
+		} else {
+			i = size;
+		}
+	}
+	playing_sample.i = uint32_t(i);
+}
+
+//helper: rough gain of a playing sample (before panning), used to decide whether to virtualize it:
+float estimate_audibility(Sound::PlayingSample const &playing_sample) {
+	float gain = playing_sample.volume.value * buses[uint32_t(playing_sample.bus)].volume.value;
+	if (!(playing_sample.pan.value == playing_sample.pan.value)) {
+		//3D: distance attenuation at start of block (from compute_pan_3D):
+		gain *= 1.0f - playing_sample.start_3D.far;
+	}
+	return gain;
+}
+
+//helper: add 'in' to 'out', scaled by a gain ramping linearly from 'start' by 'step' per sample:
+// (gain computed from 'i' rather than accumulated, so this loop vectorizes)
+inline void mix_ramped(float const *in, float *out, uint32_t count, float start, float step) {
+	for (uint32_t i = 0; i < count; ++i) {
+		out[i] += (start + float(i) * step) * in[i];
+	}
+}
+
+//helper: hand 'frames' frames to the device stream, mixing another block whenever the last one runs out
+// (called by whichever of mix_audio or feed_audio is in use, so output_block needs no locking):
+void put_frames(uint32_t frames) {
+	RealtimeCheck::Scope realtime("audio output");
+	while (frames > 0) {
+		if (output_block.frames == 0) {
+			Sound::lock();
+			uint32_t count = block_frames;
+			mix(output_block.data, count);
+			Sound::unlock();
+			output_block.read = 0;
+			output_block.frames = count;
+		}
+		uint32_t count = std::min(frames, uint32_t(output_block.frames));
+		SDL_PutAudioStreamData(stream, output_block.data + 2 * output_block.read, int(count * 2 * sizeof(float)));
+		output_block.read += count;
+		output_block.frames -= count;
+		frames -= count;
+	}
+}
 
 //The audio callback -- invoked by SDL when it needs more sound to play:
 void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount, int total_amount) {
-	if (total_amount <= 0) return;
+	if (additional_amount <= 0) return;
 	assert(stream_ == stream && "callback should only be used with our main stream");
 
-	struct LR {
-		float l;
-		float r;
+	put_frames(uint32_t(additional_amount) / (2 * sizeof(float)));
+}
+
+//The feeder thread -- keeps the device's stream topped up with mixed blocks (used instead of mix_audio with mix threads):
+void feed_audio() {
+	//keep 'ahead_frames' queued beyond the device's buffer (so a slow mix delays the next block, not the device):
+	while (!feeder_quit) {
+		uint32_t queued = uint32_t(std::max(0, SDL_GetAudioStreamQueued(stream))) / (2 * sizeof(float));
+		if (queued < ahead_frames) {
+			put_frames(block_frames);
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+	}
+}
+
+//helper: is 'playing_sample' silent (below silence_threshold when scaled by 'gain') over the next 'span' values?
+// (judged by the sample's envelope, including the values interpolation reads on either side)
+bool is_silent(Sound::PlayingSample const &playing_sample, float span, float gain) {
+	Sound::Sample const &sample = playing_sample.sample;
+	if (silence_threshold <= 0.0f || sample.envelope.empty()) return false;
+	if (gain <= 0.0f) return true;
+	float limit = silence_threshold / gain;
+	int64_t size = sample.size();
+
+	//is any envelope block covering values [begin, end) louder than limit?
+	auto loud = [&](int64_t begin, int64_t end) {
+		begin = std::max< int64_t >(begin, 0);
+		end = std::min< int64_t >(end, size);
+		if (begin >= end) return false;
+		for (int64_t b = begin / Sound::Sample::EnvelopeSize; b <= (end - 1) / Sound::Sample::EnvelopeSize; ++b) {
+			if (sample.envelope[b] > limit) return true;
+		}
+		return false;
 	};
-	static_assert(sizeof(LR) == 8, "Sample is packed");
 
-	uint32_t samples = uint32_t(total_amount) / sizeof(LR);
+	int64_t begin = int64_t(playing_sample.i) - 2;
+	int64_t end = int64_t(playing_sample.i) + int64_t(std::ceil(span)) + 3;
+	if (loud(begin, end)) return false;
+	if (playing_sample.loop) { //(wraps around)
+		if (begin < 0 && loud(size + begin, size)) return false;
+		if (end > size && loud(0, end - size)) return false;
+	}
+	return true;
+}
 
-	//adapted from older code using https://github.com/libsdl-org/SDL/blob/main/docs/README-migration.md
-	int len = samples * sizeof(LR);
-	Uint8 *buffer_ = SDL_stack_alloc(Uint8, len); //this is not actually responsive to the amount of samples requested, it just mixes in blocks of MIX_SAMPLES
+//helper: apply a scheduled event (called by the mixer, which already holds the lock the setters take):
+void apply_event(Sound::Batch::Event const &event) {
+	Sound::PlayingSample &playing_sample = *event.playing_sample;
+	if (event.type == Sound::Batch::Event::Stop) {
+		playing_sample.stop(event.ramp);
+	} else if (event.type == Sound::Batch::Event::Volume) {
+		playing_sample.set_volume(event.value.x, event.ramp);
+	} else if (event.type == Sound::Batch::Event::Pan) {
+		playing_sample.set_pan(event.value.x, event.ramp);
+	} else if (event.type == Sound::Batch::Event::Position) {
+		playing_sample.set_position(event.value, event.ramp);
+	} else { assert(event.type == Sound::Batch::Event::Rate);
+		playing_sample.set_rate(event.value.x, event.ramp);
+	}
+}
 
-	LR *buffer = reinterpret_cast< LR * >(buffer_);
+//helper: mix one playing sample into 'target' (marking it 'stopped' once it has finished):
+void mix_voice(Sound::PlayingSample &playing_sample, MixTarget &target) {
+	//scheduled to start later?
+	if (playing_sample.start >= mix_block.end_frame) return;
+	//...or partway through this block?
+	uint32_t offset = (playing_sample.start > mix_block.start_frame ? uint32_t(playing_sample.start - mix_block.start_frame) : 0);
+
+	uint32_t samples = mix_block.samples - offset;
+	float elapsed = samples / float(AUDIO_RATE);
+	float *mono = target.scratch;
+
+	//Figure out sample panning/volume (and how much is "far") at start...
+	LR start_pan;
+	float start_far = 0.0f;
+	if (!(playing_sample.pan.value == playing_sample.pan.value)) {
+		//3D panning (computed, and position stepped, in mix()):
+		start_pan = LR{playing_sample.start_3D.left, playing_sample.start_3D.right};
+		start_far = playing_sample.start_3D.far;
+	} else {
+		//2D panning
+		compute_pan_weights(playing_sample.pan.value, &start_pan.l, &start_pan.r);
 
-	//zero the output buffer:
-	for (uint32_t s = 0; s < samples; ++s) {
-		buffer[s].l = 0.0f;
-		buffer[s].r = 0.0f;
+		step_value_ramp(elapsed, playing_sample.pan);
+	}
+	start_pan.l *= playing_sample.volume.value;
+	start_pan.r *= playing_sample.volume.value;
+
+	step_value_ramp(elapsed, playing_sample.volume);
+
+	//..and end of the mix period:
+	LR end_pan;
+	float end_far = 0.0f;
+	if (!(playing_sample.pan.value == playing_sample.pan.value)) {
+		//3D panning
+		end_pan = LR{playing_sample.end_3D.left, playing_sample.end_3D.right};
+		end_far = playing_sample.end_3D.far;
+	} else {
+		//2D panning
+		compute_pan_weights(playing_sample.pan.value, &end_pan.l, &end_pan.r);
+	}
+
+	end_pan.l *= playing_sample.volume.value;
+	end_pan.r *= playing_sample.volume.value;
+
+	//step through data (in data values per output sample) at start and end of the mix period:
+	float rate_scale = float(playing_sample.sample.rate) / float(AUDIO_RATE);
+	float start_step = rate_scale * playing_sample.rate.value;
+	step_value_ramp(elapsed, playing_sample.rate);
+	float end_step = rate_scale * playing_sample.rate.value;
+
+	assert(playing_sample.i < playing_sample.sample.size());
+
+	bool audible = (playing_sample.audibility >= mix_block.cutoff);
+	if (!audible) target.virtual_voices += 1;
+
+	if (!audible && playing_sample.virtualized) {
+		//stays virtual: just keep its place:
+		advance(playing_sample, start_step, end_step, samples);
+	} else {
+		//fade in when becoming audible and out when becoming virtual, so switching doesn't click:
+		if (playing_sample.virtualized) start_pan = LR{0.0f, 0.0f};
+		if (!audible) end_pan = LR{0.0f, 0.0f};
+		playing_sample.virtualized = !audible;
+
+		//(silence is judged at the output, so include bus, master, and global volume)
+		float gain = std::max(std::max(start_pan.l, start_pan.r), std::max(end_pan.l, end_pan.r)) * mix_block.bus_gain[uint32_t(playing_sample.bus)];
+		if (is_silent(playing_sample, std::max(start_step, end_step) * samples, gain)) {
+			//nothing to hear this block: just keep its place:
+			advance(playing_sample, start_step, end_step, samples);
+			target.silent_voices += 1;
+		} else {
+			uint32_t count = resample(playing_sample, start_step, end_step, samples, mono);
+
+			//mix into bus, with pan moving smoothly from start to end:
+			uint32_t bus = uint32_t(playing_sample.bus);
+			target.near_active[bus] = true;
+			mix_ramped(mono, channel(target.scratch, mix_block.samples, bus, NearL) + offset, count, (1.0f - start_far) * start_pan.l, ((1.0f - end_far) * end_pan.l - (1.0f - start_far) * start_pan.l) / samples);
+			mix_ramped(mono, channel(target.scratch, mix_block.samples, bus, NearR) + offset, count, (1.0f - start_far) * start_pan.r, ((1.0f - end_far) * end_pan.r - (1.0f - start_far) * start_pan.r) / samples);
+			if (start_far > 0.0f || end_far > 0.0f) {
+				target.far_active[bus] = true;
+				mix_ramped(mono, channel(target.scratch, mix_block.samples, bus, FarL) + offset, count, start_far * start_pan.l, (end_far * end_pan.l - start_far * start_pan.l) / samples);
+				mix_ramped(mono, channel(target.scratch, mix_block.samples, bus, FarR) + offset, count, start_far * start_pan.r, (end_far * end_pan.r - start_far * start_pan.r) / samples);
+			}
+		}
 	}
 
+	if (playing_sample.i >= playing_sample.sample.size()
+	 || (playing_sample.stopping && playing_sample.volume.value == 0.0f)) { //sample has finished
+		playing_sample.stopped = true;
+	}
+}
+
+//helper: clear partition 'partition''s channels and mix its share of 'mixing' into them:
+void mix_partition(uint32_t partition) {
+	uint32_t partitions = uint32_t(mix_pool.helpers.size()) + 1;
+	MixTarget &target = partition_targets[partition];
+	std::fill(target.scratch + mix_block.samples, target.scratch + mix_block.samples * ScratchChannels, 0.0f);
+	std::fill(target.near_active, target.near_active + Sound::BusCount, false);
+	std::fill(target.far_active, target.far_active + Sound::BusCount, false);
+	target.virtual_voices = 0;
+	target.silent_voices = 0;
+
+	size_t begin = mixing.size() * partition / partitions;
+	size_t end = mixing.size() * (partition + 1) / partitions;
+	for (size_t i = begin; i < end; ++i) {
+		mix_voice(*mixing[i], target);
+	}
+}
+
+//mix thread helpers wait for a generation after 'seen', mix their partition, and report back:
+void mix_helper(uint32_t partition, uint64_t seen) {
+	std::unique_lock< std::mutex > pool_lock(mix_pool.mutex);
+	while (true) {
+		mix_pool.start.wait(pool_lock, [&](){ return mix_pool.quit || mix_pool.generation != seen; });
+		if (mix_pool.quit) return;
+		seen = mix_pool.generation;
+
+		pool_lock.unlock();
+		{
+			RealtimeCheck::Scope realtime("mix helper");
+			mix_partition(partition);
+		}
+		pool_lock.lock();
+
+		mix_pool.pending -= 1;
+		if (mix_pool.pending == 0) mix_pool.done.notify_one();
+	}
+}
+
+void Sound::render(float *out, uint32_t frames) {
+	lock();
+	for (uint32_t done = 0; done < frames; done += block_frames) {
+		mix(out + 2 * done, std::min(block_frames, frames - done));
+	}
+	unlock();
+}
+
+//mix one block of 'samples' (at most MaxBlockFrames) frames of interleaved stereo into 'out'
+// (called from the audio callback, feeder, or Sound::render, between Sound::lock() and Sound::unlock()):
+void mix(float *out, uint32_t samples) {
+	assert(samples <= MaxBlockFrames);
+	auto mix_start = std::chrono::steady_clock::now();
+
+	LR *buffer = reinterpret_cast< LR * >(out);
+
+	//playing samples are mixed into these channels (see Channel, above):
+	float *scratch = mix_scratch;
+	auto channel = [&](uint32_t bus, Channel c) {
+		return ::channel(scratch, samples, bus, c);
+	};
+	std::fill(scratch + samples, scratch + samples * ScratchChannels, 0.0f);
+	MixTarget target;
+	target.scratch = scratch;
+	bool *near_active = target.near_active;
+	bool *far_active = target.far_active;
+
 	//update global values:
 	float start_volume = Sound::volume.value;
 	glm::vec3 start_position =  Sound::listener.position.value;
@@ -340,100 +1544,241 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 	glm::vec3 end_position =  Sound::listener.position.value;
 	glm::vec3 end_right =  Sound::listener.right.value;
 
-	//add audio from each playing sample into the buffer:
-	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
-		Sound::PlayingSample &playing_sample = **si; //much more convenient than writing ** everywhere.
-
-		//Figure out sample panning/volume at start...
-		LR start_pan;
-		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
-			//3D panning
-			compute_pan_from_listener_and_position(
-				start_position, start_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
-				&start_pan.l, &start_pan.r);
-
-			step_position_ramp(elapsed, playing_sample.position);
-			step_value_ramp(elapsed, playing_sample.half_volume_radius);
-		} else {
-			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &start_pan.l, &start_pan.r);
+	//apply scheduled events due by the end of this block:
+	uint64_t block_start = mix_clock.load(std::memory_order_relaxed);
+	uint64_t block_end = block_start + samples;
+	while (next_event < scheduled_events.size() && scheduled_events[next_event].at < block_end) {
+		apply_event(scheduled_events[next_event]);
+		next_event += 1;
+	}
 
-			step_value_ramp(elapsed, playing_sample.pan);
+	//gather 3D playing samples' positions at start and end of the block (stepping their ramps)...
+	pan_samples.clear();
+	for (auto const &playing_sample_ : playing_samples) {
+		Sound::PlayingSample &playing_sample = *playing_sample_;
+		if (playing_sample.pan.value == playing_sample.pan.value) continue; //(2D)
+		if (playing_sample.start >= block_end) continue; //(not started yet)
+		uint32_t offset = (playing_sample.start > block_start ? uint32_t(playing_sample.start - block_start) : 0);
+		float sample_elapsed = (samples - offset) / float(AUDIO_RATE);
+
+		uint32_t group = uint32_t(pan_samples.size()) / PanLanes;
+		uint32_t lane = uint32_t(pan_samples.size()) % PanLanes;
+		if (group == pan_start.size()) {
+			pan_start.emplace_back();
+			pan_end.emplace_back();
 		}
-		start_pan.l *= start_volume * playing_sample.volume.value;
-		start_pan.r *= start_volume * playing_sample.volume.value;
-
-		step_value_ramp(elapsed, playing_sample.volume);
-
-		//..and end of the mix period:
-		LR end_pan;
-		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
-			//3D panning
-			compute_pan_from_listener_and_position(
-				end_position, end_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
-				&end_pan.l, &end_pan.r);
-		} else {
-			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &end_pan.l, &end_pan.r);
+		pan_start[group].x[lane] = playing_sample.position.value.x;
+		pan_start[group].y[lane] = playing_sample.position.value.y;
+		pan_start[group].z[lane] = playing_sample.position.value.z;
+		pan_start[group].radius[lane] = playing_sample.half_volume_radius.value;
+		step_position_ramp(sample_elapsed, playing_sample.position);
+		step_value_ramp(sample_elapsed, playing_sample.half_volume_radius);
+		pan_end[group].x[lane] = playing_sample.position.value.x;
+		pan_end[group].y[lane] = playing_sample.position.value.y;
+		pan_end[group].z[lane] = playing_sample.position.value.z;
+		pan_end[group].radius[lane] = playing_sample.half_volume_radius.value;
+
+		pan_samples.emplace_back(&playing_sample);
+	}
+	//...pad the last group (so unused lanes compute something finite)...
+	uint32_t pan_groups = (uint32_t(pan_samples.size()) + PanLanes - 1) / PanLanes;
+	for (uint32_t i = uint32_t(pan_samples.size()); i < pan_groups * PanLanes; ++i) {
+		for (PanGroup *group : {&pan_start[i / PanLanes], &pan_end[i / PanLanes]}) {
+			group->x[i % PanLanes] = group->y[i % PanLanes] = group->z[i % PanLanes] = 0.0f;
+			group->radius[i % PanLanes] = 1.0f;
 		}
+	}
+	//...and compute all of their panning together:
+	for (uint32_t g = 0; g < pan_groups; ++g) {
+		compute_pan_3D(start_position, start_right, pan_start[g]);
+		compute_pan_3D(end_position, end_right, pan_end[g]);
+	}
+	for (uint32_t i = 0; i < uint32_t(pan_samples.size()); ++i) {
+		PanGroup const &start = pan_start[i / PanLanes];
+		PanGroup const &end = pan_end[i / PanLanes];
+		uint32_t lane = i % PanLanes;
+		pan_samples[i]->start_3D = Sound::PlayingSample::Pan3D{start.left[lane], start.right[lane], start.far[lane]};
+		pan_samples[i]->end_3D = Sound::PlayingSample::Pan3D{end.left[lane], end.right[lane], end.far[lane]};
+	}
 
-		end_pan.l *= end_volume * playing_sample.volume.value;
-		end_pan.r *= end_volume * playing_sample.volume.value;
+	//decide which playing samples are loud enough to be worth mixing this block:
+	float cutoff = (max_voices ? virtual_threshold : std::numeric_limits< float >::infinity());
+	audibilities.clear();
+	for (auto const &playing_sample : playing_samples) {
+		if (playing_sample->start >= block_end) { //(not started yet, so shouldn't take a voice)
+			playing_sample->audibility = 0.0f;
+			//stopped before it started: never sound (rather than playing its fade-out once it starts):
+			if (playing_sample->stopping) playing_sample->stopped = true;
+			continue;
+		}
+		playing_sample->audibility = estimate_audibility(*playing_sample);
+		if (playing_sample->audibility >= virtual_threshold) audibilities.emplace_back(playing_sample->audibility);
+	}
+	if (max_voices && audibilities.size() > max_voices) {
+		//only the loudest max_voices:
+		std::nth_element(audibilities.begin(), audibilities.begin() + (max_voices - 1), audibilities.end(), std::greater< float >());
+		cutoff = std::max(cutoff, audibilities[max_voices - 1]);
+	}
+	uint64_t voices = playing_samples.size();
+
+	mix_block.samples = samples;
+	mix_block.start_frame = block_start;
+	mix_block.end_frame = block_end;
+	mix_block.cutoff = cutoff;
+	{ //(bus and master volumes ramp during the bus graph, so use the louder end of each ramp)
+		auto most = [](Sound::Ramp< float > const &ramp) { return std::max(ramp.value, ramp.target); };
+		uint32_t const master = uint32_t(Sound::Bus::Master);
+		float master_gain = most(buses[master].volume) * std::max(start_volume, end_volume);
+		for (uint32_t b = 0; b < Sound::BusCount; ++b) {
+			mix_block.bus_gain[b] = (b == master ? 1.0f : most(buses[b].volume)) * master_gain;
+		}
+	}
 
-		//figure out a step to add at each sample so that pan will move smoothly from start to end:
-		LR pan = start_pan;
-		LR pan_step;
-		pan_step.l = (end_pan.l - start_pan.l) / samples;
-		pan_step.r = (end_pan.r - start_pan.r) / samples;
+	//add audio from each playing sample into its bus:
+	uint32_t partitions = uint32_t(mix_pool.helpers.size()) + 1;
+	if (partitions == 1 || voices < uint64_t(partitions) * MinVoicesPerPartition) {
+		for (auto const &playing_sample : playing_samples) {
+			mix_voice(*playing_sample, target);
+		}
+	} else {
+		//split playing samples into partitions, mixed in parallel into separate channels:
+		mixing.clear();
+		for (auto const &playing_sample : playing_samples) {
+			mixing.emplace_back(playing_sample.get());
+		}
+		{ //start helpers on partitions 1..N-1:
+			std::lock_guard< std::mutex > pool_lock(mix_pool.mutex);
+			mix_pool.generation += 1;
+			mix_pool.pending = partitions - 1;
+		}
+		mix_pool.start.notify_all();
 
-		assert(playing_sample.i < playing_sample.data.size());
+		mix_partition(0);
 
-		for (uint32_t i = 0; i < samples; ++i) {
-			//mix one sample based on current pan values:
-			buffer[i].l += pan.l * playing_sample.data[playing_sample.i];
-			buffer[i].r += pan.r * playing_sample.data[playing_sample.i];
+		{ //wait for helpers to finish:
+			std::unique_lock< std::mutex > pool_lock(mix_pool.mutex);
+			#ifndef REALTIME_CHECK_LIBC
+			//(this is a real wait on other threads, so it is reported; with RealtimeCheck's pthread hooks, they do this)
+			if (mix_pool.pending != 0) RealtimeCheck::check(RealtimeCheck::Kind::Block, "waiting for mix helpers");
+			#endif
+			mix_pool.done.wait(pool_lock, [](){ return mix_pool.pending == 0; });
+		}
 
-			//update position in sample:
-			playing_sample.i += 1;
-			if (playing_sample.i == playing_sample.data.size()) {
-				if (playing_sample.loop) {
-					playing_sample.i = 0;
-				} else {
-					break;
+		//sum partitions in a fixed order (so output is the same no matter which finished first):
+		for (uint32_t partition = 0; partition < partitions; ++partition) {
+			MixTarget const &from = partition_targets[partition];
+			for (uint32_t b = 0; b < Sound::BusCount; ++b) {
+				if (from.near_active[b]) {
+					near_active[b] = true;
+					mix_ramped(::channel(from.scratch, samples, b, NearL), channel(b, NearL), samples, 1.0f, 0.0f);
+					mix_ramped(::channel(from.scratch, samples, b, NearR), channel(b, NearR), samples, 1.0f, 0.0f);
+				}
+				if (from.far_active[b]) {
+					far_active[b] = true;
+					mix_ramped(::channel(from.scratch, samples, b, FarL), channel(b, FarL), samples, 1.0f, 0.0f);
+					mix_ramped(::channel(from.scratch, samples, b, FarR), channel(b, FarR), samples, 1.0f, 0.0f);
 				}
 			}
-
-			//update pan values:
-			pan.l += pan_step.l;
-			pan.r += pan_step.r;
+			target.virtual_voices += from.virtual_voices;
+			target.silent_voices += from.silent_voices;
 		}
+	}
+	uint64_t virtual_voices = target.virtual_voices;
 
-		if (playing_sample.i >= playing_sample.data.size()
-		 || (playing_sample.stopping && playing_sample.volume.value == 0.0f)) { //sample has finished
-		 	playing_sample.stopped = true;
-			//erase from list:
+	//move finished playing samples to finished_samples (to be freed by Sound::collect()):
+	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
+		if ((*si)->stopped) {
 			auto old = si;
 			++si;
-			playing_samples.erase(old);
+			finished_samples.splice(finished_samples.end(), playing_samples, old);
 		} else {
 			++si;
 		}
 	}
 
-	/*//DEBUG: report output power:
-	float max_power = 0.0f;
-	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
-		max_power = std::max(max_power, (buffer[s].l * buffer[s].l + buffer[s].r * buffer[s].r));
+	//run the bus graph:
+	auto bus_start = std::chrono::steady_clock::now();
+
+	uint32_t const Master = uint32_t(Sound::Bus::Master);
+	for (uint32_t b = 0; b < Sound::BusCount; ++b) {
+		BusState &bus = buses[b];
+
+		//low-pass far sound (once per bus, no matter how many samples are playing) and add it to near sound:
+		if (far_active[b] || bus.far_active) {
+			bus.distance_filter.process(channel(b, FarL), channel(b, FarR), samples);
+			mix_ramped(channel(b, FarL), channel(b, NearL), samples, 1.0f, 0.0f);
+			mix_ramped(channel(b, FarR), channel(b, NearR), samples, 1.0f, 0.0f);
+			near_active[b] = true;
+		}
+		bus.far_active = far_active[b];
+
+		if (b == Master) continue; //(master is handled below, after everything has been mixed into it)
+
+		float start_bus_volume = bus.volume.value;
+		step_value_ramp(elapsed, bus.volume);
+		float end_bus_volume = bus.volume.value;
+
+		//idle buses without effects (which might have tails to play out) have nothing to add:
+		if (!near_active[b] && bus.effects.empty()) continue;
+
+		for (auto const &effect : bus.effects) {
+			effect->process(channel(b, NearL), channel(b, NearR), samples);
+		}
+		mix_ramped(channel(b, NearL), channel(Master, NearL), samples, start_bus_volume, (end_bus_volume - start_bus_volume) / samples);
+		mix_ramped(channel(b, NearR), channel(Master, NearR), samples, start_bus_volume, (end_bus_volume - start_bus_volume) / samples);
 	}
-	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing samples: " << playing_samples.size() << std::endl; //DEBUG
-	*/
 
-	SDL_PutAudioStreamData(stream, buffer_, len);
-	SDL_stack_free(buffer_);
-}
+	BusState &master = buses[Master];
+	for (auto const &effect : master.effects) {
+		effect->process(channel(Master, NearL), channel(Master, NearR), samples);
+	}
 
+	auto bus_end = std::chrono::steady_clock::now();
 
+	//master volume (including global volume) and interleave into output:
+	float start_master_volume = start_volume * master.volume.value;
+	step_value_ramp(elapsed, master.volume);
+	float end_master_volume = end_volume * master.volume.value;
+	float master_step = (end_master_volume - start_master_volume) / samples;
+	float const *master_l = channel(Master, NearL);
+	float const *master_r = channel(Master, NearR);
+	float peak = 0.0f;
+	for (uint32_t s = 0; s < samples; ++s) {
+		float v = start_master_volume + float(s) * master_step;
+		buffer[s].l = v * master_l[s];
+		buffer[s].r = v * master_r[s];
+		peak = std::max(peak, std::max(std::abs(buffer[s].l), std::abs(buffer[s].r)));
+	}
+
+	auto mix_end = std::chrono::steady_clock::now();
+
+	MixRecord record;
+	record.start_ns = std::chrono::duration_cast< std::chrono::nanoseconds >(mix_start.time_since_epoch()).count();
+	record.duration_ns = uint32_t(std::chrono::duration_cast< std::chrono::nanoseconds >(mix_end - mix_start).count());
+	record.bus_ns = uint32_t(std::chrono::duration_cast< std::chrono::nanoseconds >(bus_end - bus_start).count());
+	record.frames = samples;
+	record.voices = uint32_t(voices);
+	record.virtual_voices = uint32_t(virtual_voices);
+	record.peak = peak;
+
+	//underrun if everything mixed before had already played out by the time this callback started
+	// (with a little slack for scheduling jitter), and overrun if mixing took longer than the audio lasts:
+	constexpr int64_t const UnderrunSlackNs = 2000000;
+	int64_t audio_ns = int64_t(samples) * 1000000000 / AUDIO_RATE;
+	record.underrun = (mixed_until_ns != 0 && record.start_ns > mixed_until_ns + UnderrunSlackNs);
+	record.overrun = (int64_t(record.duration_ns) > audio_ns);
+	mixed_until_ns = std::max(mixed_until_ns, record.start_ns) + audio_ns;
+
+	mix_ring.push(record);
+
+	mix_clock.store(block_end, std::memory_order_relaxed);
+
+	mix_callbacks.fetch_add(1, std::memory_order_relaxed);
+	mix_voices.fetch_add(voices, std::memory_order_relaxed);
+	mix_virtual_voices.fetch_add(virtual_voices, std::memory_order_relaxed);
+	mix_silent_voices.fetch_add(target.silent_voices, std::memory_order_relaxed);
+	mix_ns.fetch_add(record.duration_ns, std::memory_order_relaxed);
+	bus_ns.fetch_add(record.bus_ns, std::memory_order_relaxed);
+	if (record.underrun) mix_underruns.fetch_add(1, std::memory_order_relaxed);
+	if (record.overrun) mix_overruns.fetch_add(1, std::memory_order_relaxed);
+}
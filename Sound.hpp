@@ -8,21 +8,83 @@
 #include <cmath>
 
 //Game audio system. Simplified from f18-base3.
-//Uses 48kHz sampling rate.
+//Mixes at a 48kHz sampling rate; samples are resampled on the fly from their native rates.
 
 namespace Sound {
 
+//Playing samples are mixed into buses, which apply volume and effects to everything routed to them:
+// Music, SFX, and Ambience buses all feed the Master bus.
+enum class Bus : uint8_t {
+	Music,
+	SFX,
+	Ambience,
+	Master,
+};
+constexpr uint32_t const BusCount = 4;
+
+struct Effect; //(see SoundEffects.hpp)
+
 //Sample objects hold mono (one-channel) audio.
 struct Sample {
+	//How sample data is stored in memory (decoded by the mixer as it plays):
+	enum class Encoding : uint8_t {
+		Float, //32-bit float per value
+		PCM16, //16-bit integer per value (half the memory of Float)
+		Block8, //8-bit integer per value, scaled by one float per 64-value block (a bit over a quarter the memory of Float)
+	};
+
 	//Load from a '.wav' or '.opus' file.
-	//  will warn and convert if sound is not already 48kHz mono:
-	Sample(std::string const &filename);
+	//  will warn and convert if sound is not already mono (but keeps its native sampling rate):
+	//  (throws if the file decodes to no audio)
+	Sample(std::string const &filename, Encoding encoding = Encoding::Float);
 	
-	//Directly supply an audio buffer:
-	Sample(std::vector< float > const &data);
+	//Directly supply an audio buffer (sampled at 'rate' Hz; throws if empty):
+	Sample(std::vector< float > const &data, uint32_t rate = 48000, Encoding encoding = Encoding::Float);
+
+	~Sample();
+
+	//sample data is mono, stored according to 'encoding' in one of:
+	Encoding encoding = Encoding::Float;
+	std::vector< float > data; //Float
+	std::vector< int16_t > pcm16; //PCM16
+	std::vector< int8_t > block8; //Block8 values...
+	std::vector< float > block8_scales; //...and the scale of each Block8Size values
+	static constexpr uint32_t const Block8Size = 64;
+	//...sampled at this rate (Hz):
+	uint32_t rate = 48000;
+
+	//peak absolute value of each EnvelopeSize values (so the mixer can skip quiet stretches; see set_silence_threshold):
+	std::vector< float > envelope;
+	static constexpr uint32_t const EnvelopeSize = 256;
+
+	//number of values in the sample (whatever the encoding):
+	uint32_t size() const;
+	//memory used by sample data (in bytes):
+	size_t memory() const;
+	//value 'i' of the sample (whatever the encoding):
+	float at(uint32_t i) const;
+
+	//convert Float data to 'new_encoding' (and free the Float data):
+	void encode(Encoding new_encoding);
+
+	//recompute 'envelope' from the sample data (done when loading):
+	void update_envelope();
 
-	//sample data is stored as 48kHz, mono, floating-point:
-	std::vector< float > data;
+	//read/write data (in its current encoding) from/to a decoded sample cache file
+	// (read returns false if the file is missing or unusable; it maps the file but copies the data out,
+	//  since samples own their data -- hot reloading and re-encoding replace it in place):
+	bool read_cache(std::string const &path);
+	void write_cache(std::string const &path) const;
+
+	//bus that playback of this sample is routed to (unless changed with PlayingSample::set_bus):
+	Bus bus = Bus::SFX;
+
+	//decode a '.wav' or '.opus' file to mono at its native rate:
+	static void decode(std::string const &filename, std::vector< float > *data, uint32_t *rate);
+
+	//re-decode 'filename' and swap it in (playing copies pick up the new data):
+	// (called by the hot reloading system when the file changes)
+	void reload(std::string const &filename);
 };
 
 //Ramp<> manages values that should be smoothly interpolated
@@ -59,6 +121,10 @@ struct PlayingSample {
 	void set_position(glm::vec3 const &new_position, float ramp = 1.0f / 60.0f);
 	//set the half-volume radius (use only on "3D" playing sounds):
 	void set_half_volume_radius(float new_radius, float ramp = 1.0f / 60.0f);
+	//set the playback rate (1.0f == normal speed, 2.0f == twice as fast and an octave higher):
+	void set_rate(float new_rate, float ramp = 1.0f / 60.0f);
+	//route to a different bus (takes effect at the next mixed block):
+	void set_bus(Bus new_bus);
 
 	//'stop' will fade sample out over 'ramp' seconds and then remove it from the active samples:
 	void stop(float ramp = 1.0f / 60.0f);
@@ -66,14 +132,30 @@ struct PlayingSample {
 	//internals:
 	//NOTE: PlayingSample is used in a separate thread; so setting these values directly
 	// may result in bad results. Instead, use the functions above, which perform locking!
-	std::vector< float > const &data; //reference to sample data being played
+	Sample const &sample; //sample being played (note: its data may be swapped by reload)
 	uint32_t i = 0; //next data value to read
+	float t = 0.0f; //fractional position between data[i] and data[i+1]
 	bool loop = false; //should playback loop after data runs out?
 	bool stopping = false; //is playing stopping?
 	bool stopped = false; //was playback stopped (either by running out of sample, or by stop())?
+	Bus bus = Bus::SFX; //bus being mixed into
+	float audibility = 0.0f; //estimated gain (volume and distance attenuation) at start of this mixed block
+	bool virtualized = false; //was this sample too quiet to mix last block? (still advances through data)
+	uint64_t start = 0; //output frame (see Sound::clock) playback starts on (set by Batch; mixer waits until then)
+
+	//3D panning at start and end of the current block (computed by the mixer for all 3D samples at once):
+	struct Pan3D {
+		float left = 0.0f;
+		float right = 0.0f;
+		float far = 0.0f; //(portion to low-pass for distance)
+	};
+	Pan3D start_3D, end_3D;
 
 	Ramp< float > volume = Ramp< float >(1.0f);
 
+	//playback rate (multiplies sample.rate / 48kHz to get the step through data per output sample):
+	Ramp< float > rate = Ramp< float >(1.0f);
+
 	//2D playback panning control: ('NaN' if sound played in 3D mode)
 	Ramp< float > pan = Ramp< float >(std::numeric_limits< float >::quiet_NaN());
 
@@ -81,15 +163,16 @@ struct PlayingSample {
 	Ramp< glm::vec3 > position = Ramp< glm::vec3 >(std::numeric_limits< float >::quiet_NaN());
 	Ramp< float > half_volume_radius = std::numeric_limits< float >::quiet_NaN();
 
-	PlayingSample(Sample const &sample_, float volume_, float pan_, bool loop_)
-		: data(sample_.data), loop(loop_), volume(volume_), pan(pan_) { }
-	PlayingSample(Sample const &sample_, float volume_, glm::vec3 const &position_, float half_volume_radius_, bool loop_)
-		: data(sample_.data), loop(loop_), volume(volume_), position(position_), half_volume_radius(half_volume_radius_) { }
+	PlayingSample(Sample const &sample_, float volume_, float pan_, bool loop_, float rate_ = 1.0f)
+		: sample(sample_), loop(loop_), bus(sample_.bus), volume(volume_), rate(rate_), pan(pan_) { }
+	PlayingSample(Sample const &sample_, float volume_, glm::vec3 const &position_, float half_volume_radius_, bool loop_, float rate_ = 1.0f)
+		: sample(sample_), loop(loop_), bus(sample_.bus), volume(volume_), rate(rate_), position(position_), half_volume_radius(half_volume_radius_) { }
 };
 
 // ------- global functions -------
 
-void init(); //call Sound::init() from main.cpp before using any member functions
+void init(uint32_t mix_threads = 1); //call Sound::init() from main.cpp before using any member functions
+// (with mix_threads > 1, blocks are mixed ahead on a feeder thread, see set_mix_threads)
 
 void shutdown(); //call Sound::shutdown() from main.cpp to gracefully(-ish) exit
 
@@ -98,14 +181,16 @@ void shutdown(); //call Sound::shutdown() from main.cpp to gracefully(-ish) exit
 std::shared_ptr< PlayingSample > play(
 	Sample const &sample,
 	float volume = 1.0f,
-	float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
+	float pan = 0.0f, //-1.0f == hard left, 1.0f == hard right
+	float rate = 1.0f //playback rate (e.g., vary a little to keep repeated sounds from getting monotonous)
 );
 //The play_3D version will play a sample in '3D' mode (that is, panning determined by listener position):
 std::shared_ptr< PlayingSample > play_3D(
 	Sample const &sample,
 	float volume,
 	glm::vec3 const &position,
-	float half_volume_radius = std::numeric_limits< float >::infinity()
+	float half_volume_radius = std::numeric_limits< float >::infinity(),
+	float rate = 1.0f
 );
 
 //Call 'Sound::loop' to play a sample ~forever~.
@@ -113,16 +198,66 @@ std::shared_ptr< PlayingSample > play_3D(
 std::shared_ptr< PlayingSample > loop(
 	Sample const &sample,
 	float volume = 1.0f,
-	float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
+	float pan = 0.0f, //-1.0f == hard left, 1.0f == hard right
+	float rate = 1.0f //playback rate (e.g., vary a little to keep repeated sounds from getting monotonous)
 );
 //The loop_3D version will loop a sample in '3D' mode (that is, panning determined by listener position):
 std::shared_ptr< PlayingSample > loop_3D(
 	Sample const &sample,
 	float volume,
 	glm::vec3 const &position,
-	float half_volume_radius = std::numeric_limits< float >::infinity()
+	float half_volume_radius = std::numeric_limits< float >::infinity(),
+	float rate = 1.0f
 );
 
+//frames of output mixed so far -- the clock that Batch schedules against:
+// (the frame being heard now is about Sound::latency().total seconds behind this)
+uint64_t clock();
+
+//Batch collects sample starts, stops, and parameter changes scheduled for exact output frames,
+// then hands them all to the mixer at once (one lock per submit, however many events it holds):
+//	Sound::Batch batch;
+//	uint64_t at = Sound::clock() + 4800; //(0.1 s from now)
+//	for (uint32_t beat = 0; beat < 4; ++beat) batch.play(at + beat * 12000, sample);
+//	batch.submit();
+// samples start on exactly their frame (mid-block if need be) or as soon as possible if that frame
+// has already been mixed; stops and parameter changes take effect at the start of the mixed block
+// containing their frame:
+struct Batch {
+	std::shared_ptr< PlayingSample > play(uint64_t at, Sample const &sample, float volume = 1.0f, float pan = 0.0f, float rate = 1.0f);
+	std::shared_ptr< PlayingSample > play_3D(uint64_t at, Sample const &sample, float volume, glm::vec3 const &position, float half_volume_radius = std::numeric_limits< float >::infinity(), float rate = 1.0f);
+	std::shared_ptr< PlayingSample > loop(uint64_t at, Sample const &sample, float volume = 1.0f, float pan = 0.0f, float rate = 1.0f);
+	std::shared_ptr< PlayingSample > loop_3D(uint64_t at, Sample const &sample, float volume, glm::vec3 const &position, float half_volume_radius = std::numeric_limits< float >::infinity(), float rate = 1.0f);
+
+	//as the PlayingSample functions of the same names, but at frame 'at':
+	void stop(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float ramp = 1.0f / 60.0f);
+	void set_volume(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_volume, float ramp = 1.0f / 60.0f);
+	void set_pan(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_pan, float ramp = 1.0f / 60.0f);
+	void set_position(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, glm::vec3 const &new_position, float ramp = 1.0f / 60.0f);
+	void set_rate(uint64_t at, std::shared_ptr< PlayingSample > const &playing_sample, float new_rate, float ramp = 1.0f / 60.0f);
+
+	//hand everything to the mixer (and clear the batch for reuse):
+	void submit();
+
+	//internals:
+	struct Event {
+		enum Type : uint8_t {
+			Stop,
+			Volume,
+			Pan,
+			Position,
+			Rate,
+		};
+		uint64_t at = 0;
+		Type type = Stop;
+		std::shared_ptr< PlayingSample > playing_sample;
+		glm::vec3 value = glm::vec3(0.0f); //(x for all but Position)
+		float ramp = 0.0f;
+	};
+	std::vector< std::shared_ptr< PlayingSample > > starts;
+	std::vector< Event > events;
+};
+
 //Listener controls the panning of "3D" samples (ones played using the "position" version of the play functions):
 struct Listener {
 	void set_position_right(glm::vec3 const &new_position, glm::vec3 const &new_right, float ramp = 1.0f / 60.0f);
@@ -140,7 +275,103 @@ void stop_all_samples();
 void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 extern Ramp< float > volume;
 
-//the audio callback doesn't run between Sound::lock() and Sound::unlock()
+//set volume of one bus:
+void set_bus_volume(Bus bus, float new_volume, float ramp = 1.0f / 60.0f);
+
+//replace the chain of effects applied (in order) to everything mixed into a bus:
+void set_bus_effects(Bus bus, std::vector< std::shared_ptr< Effect > > const &effects);
+
+//"3D" samples are low-passed more the further they are from the listener
+// (each bus filters all its distant sound at once, rather than filtering each playing sample):
+void set_distance_lowpass(float frequency);
+
+//playing samples quieter than 'threshold' (gain after volume and distance attenuation) or beyond the
+// 'max_voices' loudest are "virtual": they keep their place in their data, but aren't mixed until audible again:
+// (defaults: 0.001 [-60dB] and 64)
+void set_virtualization(float threshold, uint32_t max_voices);
+
+//keep decoded (and encoded) sample data in this directory, named by a hash of the source file's contents,
+// so later runs (and unchanged files) skip decoding; call before loading samples ("" for no cache):
+// (not used when a startup snapshot is active, since that already stores decoded data)
+void set_cache_directory(std::string const &path);
+
+//time spent loading samples so far (e.g., to report after loading):
+struct LoadTimes {
+	uint32_t samples = 0;
+	uint32_t cached = 0; //...of which were read from the cache
+	double seconds = 0.0;
+};
+LoadTimes load_times();
+
+//the mixer skips (but keeps the place of) playing samples whose data over the next block peaks below
+// 'threshold' after panning and volume, judged by each Sample's envelope (0 mixes everything):
+void set_silence_threshold(float threshold = 1.0e-4f);
+
+//audio is mixed in fixed blocks of 'block_frames' frames (clamped to 32..1024), and the device's buffer
+// is sized so that (with anything queued ahead of it) about 'seconds' of audio are waiting to be played;
+// call before Sound::init() (smaller values respond sooner but wake the mixer more often):
+void set_latency(float seconds, uint32_t block_frames = 256);
+
+//current output latency (e.g., to report at startup):
+struct Latency {
+	float target = 0.0f; //seconds, as passed to set_latency
+	uint32_t block_frames = 0; //frames mixed at a time
+	uint32_t device_frames = 0; //frames in the device's buffer (0 without a device)
+	float queued = 0.0f; //seconds mixed but not yet taken by the device
+	float total = 0.0f; //device buffer + queued: about how long until a newly played sample is heard
+};
+Latency latency();
+
+//mix playing samples on this many threads (the mixing thread plus helpers), for very high voice counts:
+// each thread mixes a contiguous share of the playing samples into its own bus channels, which are then
+// summed in a fixed order, so output doesn't depend on thread timing (it can differ in the last bits
+// between thread counts); blocks with few playing samples are still mixed on one thread:
+void set_mix_threads(uint32_t threads);
+
+//mix 'frames' frames of interleaved stereo audio into 'out' right away (in blocks, as above)
+// (for rendering without an audio device, e.g., in benchmarks; avoid while the device is also playing):
+void render(float *out, uint32_t frames);
+
+//free playing samples that have finished since the last call (call once a frame from the main thread):
+// the mixer sets them aside rather than freeing them itself, so the audio thread never frees memory:
+void collect();
+
+//time spent in the audio callback so far (e.g., to report at exit; each mixed block counts as a "callback"):
+struct MixTimes {
+	uint64_t callbacks = 0;
+	double mix_seconds = 0.0; //total time in the callback
+	double bus_seconds = 0.0; //...of which was spent running the bus graph (filters and effects)
+	uint64_t voices = 0; //playing samples, summed over all callbacks
+	uint64_t virtual_voices = 0; //...of which were virtual (not mixed)
+	uint64_t silent_voices = 0; //...or were skipped for being silent this block (see set_silence_threshold)
+	uint64_t underruns = 0; //callbacks that started after all previously mixed audio had played (see MixStats)
+	uint64_t overruns = 0; //callbacks that took longer than the audio they mixed
+};
+MixTimes mix_times();
+
+//statistics about recent audio callbacks (the mixer records these without locking, so reading is cheap):
+struct MixStats {
+	uint32_t callbacks = 0; //callbacks in the window
+	float seconds = 0.0f; //time from the first of them until now
+	float duration_avg_us = 0.0f; //time spent mixing per callback
+	float duration_max_us = 0.0f;
+	float bus_max_us = 0.0f; //(of which in the bus graph)
+	float load_avg = 0.0f; //time spent mixing / length of audio mixed (above 1 can't keep up)
+	float load_max = 0.0f;
+	uint32_t frames_min = 0; //frames mixed per callback (the block size, except for Sound::render's partial blocks)
+	uint32_t frames_max = 0;
+	float voices_avg = 0.0f; //playing samples per callback
+	uint32_t voices_max = 0;
+	float virtual_avg = 0.0f; //...of which virtual
+	uint32_t virtual_max = 0;
+	float peak = 0.0f; //largest absolute output value (above 1 clips)
+	uint32_t underruns = 0; //callbacks that started after all previously mixed audio should have played out
+	uint32_t overruns = 0; //callbacks that took longer than the audio they mixed
+};
+//aggregate over callbacks in the last 'seconds' (at most the last 1024 callbacks):
+MixStats mix_stats(float seconds = 1.0f);
+
+//the mixer doesn't run between Sound::lock() and Sound::unlock()
 // the set_*/stop/play/... functions already use these helpers, so you shouldn't need
 // to call them unless your code is modifying values directly:
 void lock();
@@ -0,0 +1,197 @@
+#include "SoundEffects.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//local (to this file) helpers:
+namespace {
+	constexpr float const AUDIO_RATE = 48000.0f; //(same as the mixer)
+
+	//process long inputs in blocks of this many samples (sizes the scratch arrays below):
+	constexpr uint32_t const Block = 256;
+
+	//feedback comb: out += delayed; delayed <- in + feedback * delayed
+	void comb(Sound::Reverb::Delay &delay, float const *in, float *out, uint32_t count, float feedback) {
+		uint32_t size = uint32_t(delay.buffer.size());
+		uint32_t k = 0;
+		while (k < count) {
+			//contiguous run of the delay line:
+			uint32_t n = std::min(count - k, size - delay.at);
+			float *buffer = delay.buffer.data() + delay.at;
+			for (uint32_t j = 0; j < n; ++j) {
+				float delayed = buffer[j];
+				out[k + j] += delayed;
+				buffer[j] = in[k + j] + feedback * delayed;
+			}
+			k += n;
+			delay.at += n;
+			if (delay.at == size) delay.at = 0;
+		}
+	}
+
+	//allpass (Freeverb-style, in place):
+	void allpass(Sound::Reverb::Delay &delay, float *inout, uint32_t count) {
+		uint32_t size = uint32_t(delay.buffer.size());
+		uint32_t k = 0;
+		while (k < count) {
+			uint32_t n = std::min(count - k, size - delay.at);
+			float *buffer = delay.buffer.data() + delay.at;
+			for (uint32_t j = 0; j < n; ++j) {
+				float delayed = buffer[j];
+				float in = inout[k + j];
+				inout[k + j] = delayed - in;
+				buffer[j] = in + 0.5f * delayed;
+			}
+			k += n;
+			delay.at += n;
+			if (delay.at == size) delay.at = 0;
+		}
+	}
+}
+
+//------------------------------------------------
+
+Sound::Biquad::Biquad(Type type, float frequency, float q) {
+	float w0 = 2.0f * 3.1415926f * std::min(frequency, 0.49f * AUDIO_RATE) / AUDIO_RATE;
+	float cos_w0 = std::cos(w0);
+	float alpha = std::sin(w0) / (2.0f * q);
+
+	float a0 = 1.0f + alpha;
+	a1 = -2.0f * cos_w0 / a0;
+	a2 = (1.0f - alpha) / a0;
+	if (type == LowPass) {
+		b0 = 0.5f * (1.0f - cos_w0) / a0;
+		b1 = (1.0f - cos_w0) / a0;
+		b2 = b0;
+	} else if (type == HighPass) {
+		b0 = 0.5f * (1.0f + cos_w0) / a0;
+		b1 = -(1.0f + cos_w0) / a0;
+		b2 = b0;
+	} else { assert(type == BandPass);
+		b0 = alpha / a0;
+		b1 = 0.0f;
+		b2 = -alpha / a0;
+	}
+}
+
+void Sound::Biquad::process(float *left, float *right, uint32_t count) {
+	//each output depends on the previous one, so instead of vectorizing over time,
+	// run the two channels' (independent) recurrences together:
+	float l1 = z1[0], l2 = z2[0];
+	float r1 = z1[1], r2 = z2[1];
+	for (uint32_t i = 0; i < count; ++i) {
+		float l = left[i];
+		float r = right[i];
+		float yl = b0 * l + l1;
+		float yr = b0 * r + r1;
+		l1 = b1 * l - a1 * yl + l2;
+		r1 = b1 * r - a1 * yr + r2;
+		l2 = b2 * l - a2 * yl;
+		r2 = b2 * r - a2 * yr;
+		left[i] = yl;
+		right[i] = yr;
+	}
+	z1[0] = l1; z2[0] = l2;
+	z1[1] = r1; z2[1] = r2;
+}
+
+//------------------------------------------------
+
+Sound::Reverb::Reverb(float room, float damping_, float wet_)
+	: feedback(0.7f + 0.28f * std::clamp(room, 0.0f, 1.0f)), damping(std::clamp(damping_, 0.0f, 1.0f)), wet(wet_) {
+	//Freeverb's tunings (scaled from 44.1kHz to 48kHz), with the right channel slightly longer for stereo spread:
+	constexpr uint32_t const CombLengths[4] = {1214, 1293, 1390, 1476};
+	constexpr uint32_t const AllpassLengths[2] = {605, 480};
+	constexpr uint32_t const StereoSpread = 25;
+	for (uint32_t c = 0; c < 2; ++c) {
+		for (uint32_t i = 0; i < 4; ++i) {
+			combs[c][i].buffer.assign(CombLengths[i] + c * StereoSpread, 0.0f);
+		}
+		for (uint32_t i = 0; i < 2; ++i) {
+			allpasses[c][i].buffer.assign(AllpassLengths[i] + c * StereoSpread, 0.0f);
+		}
+	}
+}
+
+void Sound::Reverb::process(float *left, float *right, uint32_t count) {
+	constexpr float const InputGain = 0.03f;
+
+	float input[Block];
+	float reverbed[Block];
+
+	for (uint32_t begin = 0; begin < count; begin += Block) {
+		uint32_t n = std::min(Block, count - begin);
+		float *l = left + begin;
+		float *r = right + begin;
+
+		//mono input, low-passed to damp the high end of the tail:
+		for (uint32_t i = 0; i < n; ++i) {
+			input[i] = InputGain * (l[i] + r[i]);
+		}
+		float d = damped;
+		for (uint32_t i = 0; i < n; ++i) {
+			d += (1.0f - damping) * (input[i] - d);
+			input[i] = d;
+		}
+		damped = d;
+
+		for (uint32_t c = 0; c < 2; ++c) {
+			std::fill(reverbed, reverbed + n, 0.0f);
+			for (auto &delay : combs[c]) {
+				comb(delay, input, reverbed, n, feedback);
+			}
+			for (auto &delay : allpasses[c]) {
+				allpass(delay, reverbed, n);
+			}
+			float *out = (c == 0 ? l : r);
+			for (uint32_t i = 0; i < n; ++i) {
+				out[i] += wet * reverbed[i];
+			}
+		}
+	}
+}
+
+//------------------------------------------------
+
+Sound::Compressor::Compressor(float threshold_db_, float ratio_, float attack_, float release_, float makeup_db)
+	: threshold_db(threshold_db_), ratio(std::max(1.0f, ratio_)), attack(attack_), release(release_), makeup(std::pow(10.0f, makeup_db / 20.0f)) {
+}
+
+void Sound::Compressor::process(float *left, float *right, uint32_t count) {
+	constexpr uint32_t const SubBlock = 32;
+	//envelope smoothing per sub-block:
+	float attack_coef = (attack > 0.0f ? std::exp(-float(SubBlock) / (attack * AUDIO_RATE)) : 0.0f);
+	float release_coef = (release > 0.0f ? std::exp(-float(SubBlock) / (release * AUDIO_RATE)) : 0.0f);
+	float slope = 1.0f - 1.0f / ratio; //(1 for a limiter)
+
+	for (uint32_t begin = 0; begin < count; begin += SubBlock) {
+		uint32_t n = std::min(SubBlock, count - begin);
+		float *l = left + begin;
+		float *r = right + begin;
+
+		//peak level of this sub-block:
+		float peak = 0.0f;
+		for (uint32_t i = 0; i < n; ++i) {
+			peak = std::max(peak, std::max(std::abs(l[i]), std::abs(r[i])));
+		}
+		float level_db = 20.0f * std::log10(std::max(peak, 1.0e-6f));
+
+		float coef = (level_db > envelope_db ? attack_coef : release_coef);
+		envelope_db = level_db + coef * (envelope_db - level_db);
+
+		float over_db = envelope_db - threshold_db;
+		float target = makeup * (over_db > 0.0f ? std::pow(10.0f, -over_db * slope / 20.0f) : 1.0f);
+
+		//gain reductions apply from the start of the sub-block (so the peak that caused them is already reduced);
+		// increases ramp from last sub-block's gain to this one's:
+		if (target < gain) gain = target;
+		float step = (target - gain) / n;
+		for (uint32_t i = 0; i < n; ++i) {
+			float g = gain + step * float(i + 1);
+			l[i] *= g;
+			r[i] *= g;
+		}
+		gain = target;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Effects for Sound's buses (see Sound::set_bus_effects).
+ *
+ * Effects process blocks of planar (separate left and right) 48kHz audio in place
+ * and are only ever called from the audio thread, so their state needs no locking.
+ * Set up an effect's parameters before handing it to Sound::set_bus_effects
+ * (to change them later, install a new effect).
+ *
+ * Inner loops are written to be auto-vectorized (straight loops over the block with
+ * no loop-carried dependencies); recursive filters instead run both channels side by side.
+ */
+
+namespace Sound {
+
+struct Effect {
+	virtual ~Effect() = default;
+	//process 'count' samples of 'left' and 'right' in place:
+	virtual void process(float *left, float *right, uint32_t count) = 0;
+};
+
+//Second-order IIR filter (coefficients from the Audio EQ Cookbook):
+struct Biquad : Effect {
+	enum Type : uint8_t {
+		LowPass,
+		HighPass,
+		BandPass,
+	};
+	Biquad(Type type, float frequency, float q = 0.7071f);
+	virtual void process(float *left, float *right, uint32_t count) override;
+
+	//coefficients (normalized so a0 == 1):
+	float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+	//per-channel state (transposed direct form II):
+	float z1[2] = {0.0f, 0.0f};
+	float z2[2] = {0.0f, 0.0f};
+};
+
+//Small Schroeder-style reverb (four feedback combs into two allpasses per channel):
+// delay lines are processed in contiguous runs, where each sample is read once and
+// written once, so runs are independent multiply-adds.
+struct Reverb : Effect {
+	//room: 0 (small) to 1 (large); damping: 0 (bright) to 1 (dull); wet: level of reverberated signal
+	Reverb(float room = 0.5f, float damping = 0.5f, float wet = 0.25f);
+	virtual void process(float *left, float *right, uint32_t count) override;
+
+	float feedback;
+	float damping;
+	float wet;
+
+	//delay line with a read/write position:
+	struct Delay {
+		std::vector< float > buffer;
+		uint32_t at = 0;
+	};
+	Delay combs[2][4];
+	Delay allpasses[2][2];
+	float damped = 0.0f; //one-pole low-pass state for input damping
+};
+
+//Feed-forward peak compressor; use ratio = infinity for a limiter.
+// gain is computed from each 32-sample sub-block's peak; reductions apply to that whole sub-block
+// (so, with attack = 0, a limiter's output doesn't exceed its threshold), while increases ramp linearly across it:
+struct Compressor : Effect {
+	Compressor(float threshold_db = -12.0f, float ratio = 4.0f, float attack = 0.005f, float release = 0.1f, float makeup_db = 0.0f);
+	virtual void process(float *left, float *right, uint32_t count) override;
+
+	float threshold_db;
+	float ratio;
+	float attack; //seconds
+	float release; //seconds
+	float makeup; //linear
+
+	float envelope_db = -120.0f; //smoothed level
+	float gain = 1.0f; //gain applied at end of last block
+};
+
+} //namespace Sound
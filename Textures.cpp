@@ -0,0 +1,245 @@
+#include "Textures.hpp"
+
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+size_t Textures::upload_budget = 8 * 1024 * 1024;
+
+//local (to this file) data used by the texture streaming system:
+namespace {
+
+	//a file waiting to be decoded:
+	struct DecodeJob {
+		GLuint texture = 0;
+		std::string filename;
+	};
+
+	//a decoded image waiting to be uploaded:
+	struct Decoded {
+		GLuint texture = 0;
+		glm::uvec2 size = glm::uvec2(0);
+		std::vector< glm::u8vec4 > data;
+	};
+
+	//pixel buffers used to stream images to the GPU:
+	struct PixelBuffer {
+		GLuint buffer = 0;
+		GLsync fence = 0; //non-zero while the GPU may still be reading from buffer
+		GLuint texture = 0; //texture being uploaded from buffer
+	};
+	constexpr uint32_t const PixelBufferCount = 4;
+	std::array< PixelBuffer, PixelBufferCount > pixel_buffers;
+
+	//state of each texture managed by this system:
+	enum class Status {
+		Decoding,
+		Uploading,
+		Ready,
+		Failed
+	};
+	std::unordered_map< GLuint, Status > statuses; //only touched on the main thread
+
+	//worker threads + queues (guarded by 'mutex'):
+	std::vector< std::thread > workers;
+	std::mutex mutex;
+	std::condition_variable jobs_cv;
+	std::deque< DecodeJob > jobs;
+	std::deque< Decoded > decoded;
+	std::vector< GLuint > failed;
+	bool quit = false;
+
+	void worker_main() {
+		std::unique_lock< std::mutex > lock(mutex);
+		while (true) {
+			jobs_cv.wait(lock, [](){ return quit || !jobs.empty(); });
+			if (quit) break;
+			DecodeJob job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+
+			Decoded result;
+			result.texture = job.texture;
+			bool ok = true;
+			try {
+				load_png(job.filename, &result.size, &result.data, LowerLeftOrigin);
+			} catch (std::exception &e) {
+				std::cerr << "WARNING: failed to load texture '" << job.filename << "': " << e.what() << std::endl;
+				ok = false;
+			}
+
+			lock.lock();
+			if (ok) decoded.emplace_back(std::move(result));
+			else failed.emplace_back(job.texture);
+		}
+	}
+
+}
+
+void Textures::init(uint32_t worker_count) {
+	assert(workers.empty() && "Textures::init should only be called once");
+	if (worker_count == 0) {
+		worker_count = std::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1;
+	}
+	quit = false;
+	for (uint32_t i = 0; i < worker_count; ++i) {
+		workers.emplace_back(worker_main);
+	}
+	for (auto &pb : pixel_buffers) {
+		glGenBuffers(1, &pb.buffer);
+	}
+	GL_ERRORS();
+}
+
+void Textures::shutdown() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+		jobs.clear();
+	}
+	jobs_cv.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	decoded.clear();
+	failed.clear();
+
+	for (auto &pb : pixel_buffers) {
+		if (pb.fence) glDeleteSync(pb.fence);
+		pb.fence = 0;
+		if (pb.buffer) glDeleteBuffers(1, &pb.buffer);
+		pb.buffer = 0;
+	}
+	statuses.clear();
+}
+
+GLuint Textures::load(std::string const &filename, glm::u8vec4 const &placeholder) {
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+
+	//fill with placeholder until the real image arrives:
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GL_ERRORS();
+
+	statuses[tex] = Status::Decoding;
+
+	if (workers.empty()) {
+		std::cerr << "WARNING: Textures::load('" << filename << "') called before Textures::init(); texture will stay a placeholder." << std::endl;
+		statuses[tex] = Status::Failed;
+		return tex;
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(DecodeJob{ tex, filename });
+	}
+	jobs_cv.notify_one();
+
+	return tex;
+}
+
+bool Textures::ready(GLuint texture) {
+	auto f = statuses.find(texture);
+	return f != statuses.end() && f->second == Status::Ready;
+}
+
+void Textures::update() {
+	//retire uploads whose pixel buffers the GPU is done reading:
+	for (auto &pb : pixel_buffers) {
+		if (!pb.fence) continue;
+		GLenum result = glClientWaitSync(pb.fence, 0, 0); //zero timeout: never blocks
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+			glDeleteSync(pb.fence);
+			pb.fence = 0;
+			statuses[pb.texture] = Status::Ready;
+			pb.texture = 0;
+		}
+	}
+
+	//grab any finished decodes:
+	std::deque< Decoded > to_upload;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		for (GLuint tex : failed) {
+			statuses[tex] = Status::Failed;
+		}
+		failed.clear();
+		if (decoded.empty()) return;
+		//only take as many as there are free pixel buffers:
+		uint32_t free_buffers = 0;
+		for (auto const &pb : pixel_buffers) {
+			if (!pb.fence) free_buffers += 1;
+		}
+		while (!decoded.empty() && to_upload.size() < free_buffers) {
+			to_upload.emplace_back(std::move(decoded.front()));
+			decoded.pop_front();
+		}
+	}
+
+	size_t budget = upload_budget;
+	for (auto &pb : pixel_buffers) {
+		if (to_upload.empty()) break;
+		if (pb.fence) continue;
+
+		Decoded &image = to_upload.front();
+		size_t bytes = image.data.size() * sizeof(glm::u8vec4);
+		if (bytes > budget && budget != upload_budget) break; //over budget; resume next frame
+		budget -= std::min(budget, bytes);
+
+		//copy pixels into (freshly orphaned) pixel buffer:
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pb.buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (dst) {
+			std::memcpy(dst, image.data.data(), bytes);
+		}
+		if (!dst || glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE) {
+			//(unmap can fail if buffer contents were lost; try again next frame)
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			break;
+		}
+
+		//re-specify texture from pixel buffer (returns without waiting for the transfer):
+		glBindTexture(GL_TEXTURE_2D, image.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.size.x, image.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		pb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pb.texture = image.texture;
+		statuses[image.texture] = Status::Uploading;
+
+		to_upload.pop_front();
+	}
+
+	//anything that didn't fit goes back to the front of the queue (in order):
+	if (!to_upload.empty()) {
+		std::unique_lock< std::mutex > lock(mutex);
+		while (!to_upload.empty()) {
+			decoded.emplace_front(std::move(to_upload.back()));
+			to_upload.pop_back();
+		}
+	}
+
+	GL_ERRORS();
+}
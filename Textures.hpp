@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Textures streams images from PNG files into OpenGL textures without
+ * blocking the main thread:
+ *
+ *  - Textures::load() returns a texture name right away; until the image is
+ *    ready the texture holds a 1x1 placeholder color, so it can be put in a
+ *    Scene::Drawable::Pipeline immediately.
+ *  - PNG decoding happens on worker threads.
+ *  - Textures::update() (called once per frame by main.cpp) copies decoded
+ *    images into pixel buffer objects, re-specifies the texture from them,
+ *    generates mipmaps, and uses fences to know when each buffer can be reused.
+ *
+ * Since the texture *name* never changes, drawables "swap" to the real image
+ * as soon as its upload is executed -- no pipeline patching needed.
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <cstddef>
+
+namespace Textures {
+
+//call from main.cpp after the OpenGL context is created (and before loading assets):
+// 'workers' is the number of decoding threads (0 == pick based on core count)
+void init(uint32_t workers = 0);
+
+//call from main.cpp before the OpenGL context is destroyed:
+void shutdown();
+
+//start streaming 'filename' into a new texture:
+// the texture samples as 'placeholder' until the image is uploaded.
+// (if decoding fails, a warning is printed and the placeholder remains.)
+GLuint load(std::string const &filename, glm::u8vec4 const &placeholder = glm::u8vec4(0xff));
+
+//has the image for 'texture' finished uploading?
+bool ready(GLuint texture);
+
+//upload any decoded images (call once per frame, with the OpenGL context current):
+void update();
+
+//maximum number of bytes to copy into pixel buffers per update():
+// (at least one image is always started per update, even if it exceeds the budget)
+extern size_t upload_budget;
+
+} //namespace Textures
@@ -0,0 +1,302 @@
+//Benchmark for Sound's sample encodings: for each encoding, reports memory per minute of audio,
+// encoding error, and mixing cost per playing sample -- both at the sample's own rate and
+// resampled (mixes offline with Sound::render, so no audio device is needed).
+//
+//Usage:
+//	bench-audio [--voices N] [--seconds S] [path/to/sound.wav|.opus]
+//	bench-audio --scaling [path/to/sound.wav|.opus]
+//	bench-audio --silence [--voices N] [--seconds S] [path/to/sound.wav|.opus]
+// (defaults to a synthetic test signal; with --silence, to sparse synthetic sound effects)
+//
+//With --scaling, instead finds the most playing samples that can be mixed within a 5ms latency
+// budget with 1, 2, 4, and 8 mix threads (see Sound::set_mix_threads).
+//
+//With --silence, instead compares mixing cost with and without skipping silent stretches
+// (see Sound::set_silence_threshold), with voices spread evenly through the sample.
+
+#include "Sound.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	//seconds since 'before':
+	float since(std::chrono::high_resolution_clock::time_point before) {
+		return std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - before).count();
+	}
+
+	//ten seconds of tones plus a little noise, with a slow swell (so blocks have different levels):
+	std::vector< float > test_signal(uint32_t rate) {
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > noise(-1.0f, 1.0f);
+		std::vector< float > data(10 * rate);
+		for (uint32_t i = 0; i < data.size(); ++i) {
+			float t = float(i) / rate;
+			float swell = 0.5f + 0.45f * std::sin(2.0f * 3.1415926f * 0.25f * t);
+			data[i] = swell * (0.4f * std::sin(2.0f * 3.1415926f * 220.0f * t)
+			                 + 0.2f * std::sin(2.0f * 3.1415926f * 331.0f * t)
+			                 + 0.1f * std::sin(2.0f * 3.1415926f * 1250.0f * t)
+			                 + 0.05f * noise(mt));
+		}
+		return data;
+	}
+
+	//ten seconds of short, decaying bursts with silence between (like sparse sound effects):
+	std::vector< float > sparse_signal(uint32_t rate) {
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > noise(-1.0f, 1.0f);
+		std::vector< float > data(10 * rate, 0.0f);
+		for (uint32_t burst = 0; burst < 10; ++burst) {
+			uint32_t begin = burst * rate + rate / 4;
+			for (uint32_t i = 0; i < rate / 10; ++i) {
+				float t = float(i) / rate;
+				data[begin + i] = std::exp(-40.0f * t) * (0.5f * std::sin(2.0f * 3.1415926f * 440.0f * t) + 0.3f * noise(mt));
+			}
+		}
+		return data;
+	}
+
+	//can 'voice_count' (resampled, looping) copies of 'sample' be mixed in blocks of 'frames' frames
+	// with 95% of blocks taking no longer than the audio they hold?
+	bool sustainable(Sound::Sample const &sample, uint32_t voice_count, uint32_t frames) {
+		constexpr uint32_t const Blocks = 100;
+		std::vector< float > block(2 * frames);
+		std::vector< float > times;
+		times.reserve(Blocks);
+
+		//mix every voice, no matter how many:
+		Sound::set_virtualization(0.0f, voice_count);
+
+		std::vector< std::shared_ptr< Sound::PlayingSample > > voices;
+		voices.reserve(voice_count);
+		for (uint32_t v = 0; v < voice_count; ++v) {
+			float pan = (voice_count > 1 ? 2.0f * v / (voice_count - 1) - 1.0f : 0.0f);
+			voices.emplace_back(Sound::loop(sample, 1.0f / voice_count, pan, 1.06f * 48000.0f / sample.rate));
+		}
+		for (uint32_t b = 0; b < 10; ++b) { //warm up
+			Sound::render(block.data(), frames);
+		}
+		for (uint32_t b = 0; b < Blocks; ++b) {
+			auto before = std::chrono::high_resolution_clock::now();
+			Sound::render(block.data(), frames);
+			times.emplace_back(since(before));
+		}
+		for (auto &voice : voices) {
+			voice->stop(0.0f);
+		}
+		Sound::render(block.data(), frames); //(removes stopped voices)
+		Sound::collect(); //(...and frees them)
+
+		std::nth_element(times.begin(), times.begin() + (Blocks * 95 / 100), times.end());
+		return times[Blocks * 95 / 100] <= frames / 48000.0f;
+	}
+
+	//most voices sustainable (as above), by doubling then bisecting:
+	uint32_t max_voices(Sound::Sample const &sample, uint32_t frames) {
+		constexpr uint32_t const Limit = 1 << 16;
+		if (!sustainable(sample, 1, frames)) return 0;
+		uint32_t good = 1;
+		uint32_t bad = 2;
+		while (bad < Limit && sustainable(sample, bad, frames)) {
+			good = bad;
+			bad *= 2;
+		}
+		if (bad >= Limit) return good;
+		//bisect to within ~2%:
+		while (bad - good > std::max(1u, good / 50)) {
+			uint32_t mid = good + (bad - good) / 2;
+			if (sustainable(sample, mid, frames)) good = mid;
+			else bad = mid;
+		}
+		return good;
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t voice_count = 32;
+	float seconds = 5.0f;
+	std::string filename;
+	bool scaling = false;
+	bool silence = false;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--voices" && argi + 1 < argc) {
+			argi += 1;
+			voice_count = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--seconds" && argi + 1 < argc) {
+			argi += 1;
+			seconds = std::max(0.1f, float(std::atof(argv[argi])));
+		} else if (arg == "--scaling") {
+			scaling = true;
+		} else if (arg == "--silence") {
+			silence = true;
+		} else if (arg.size() > 0 && arg[0] != '-' && filename == "") {
+			filename = arg;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--voices N] [--seconds S] [path/to/sound.wav|.opus]\n\t" << argv[0] << " --scaling [path/to/sound.wav|.opus]\n\t" << argv[0] << " --silence [--voices N] [--seconds S] [path/to/sound.wav|.opus]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector< float > data;
+	uint32_t rate = 48000;
+	try {
+		if (filename != "") {
+			Sound::Sample::decode(filename, &data, &rate);
+		} else if (silence) {
+			filename = "(sparse test signal)";
+			data = sparse_signal(rate);
+		} else {
+			filename = "(test signal)";
+			data = test_signal(rate);
+		}
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	if (data.empty()) {
+		std::cerr << "ERROR: '" << filename << "' has no audio." << std::endl;
+		return 1;
+	}
+
+	if (scaling) {
+		//5ms of audio per block:
+		constexpr uint32_t const Frames = 240;
+		Sound::Sample sample(data, rate);
+
+		std::cout << filename << ": most playing samples (resampled) mixed in " << Frames << "-frame blocks with p95 mix time under " << Frames / 48.0f << " ms:\n";
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "  threads   voices   speedup\n";
+		uint32_t base = 0;
+		for (uint32_t threads : {1u, 2u, 4u, 8u}) {
+			Sound::set_mix_threads(threads);
+			uint32_t voices = max_voices(sample, Frames);
+			if (threads == 1) base = voices;
+			std::cout << "  " << std::setw(7) << threads << std::setw(9) << voices << std::setw(9) << (base ? float(voices) / base : 0.0f) << "x" << std::endl;
+		}
+		Sound::set_mix_threads(1);
+		return 0;
+	}
+
+	//mix every voice, no matter how quiet:
+	Sound::set_virtualization(0.0f, voice_count);
+
+	constexpr uint32_t const BlockFrames = 512;
+	std::vector< float > block(2 * BlockFrames);
+	uint32_t blocks = uint32_t(std::ceil(seconds * 48000.0f / BlockFrames));
+	float mixed_seconds = blocks * BlockFrames / 48000.0f;
+
+	if (silence) {
+		Sound::Sample sample(data, rate);
+
+		uint32_t quiet = uint32_t(std::count_if(sample.envelope.begin(), sample.envelope.end(), [](float peak){ return peak < 1.0e-4f; }));
+		std::cout << filename << ": " << data.size() << " values at " << rate << " Hz, " << quiet << " of " << sample.envelope.size() << " envelope blocks below -80 dB; mixing " << voice_count << " voices for " << mixed_seconds << " s.\n";
+		std::cout << std::fixed << std::setprecision(2);
+
+		float costs[2];
+		float const thresholds[2] = { 0.0f, 1.0e-4f };
+		for (uint32_t t = 0; t < 2; ++t) {
+			Sound::set_silence_threshold(thresholds[t]);
+			Sound::MixTimes before_times = Sound::mix_times();
+
+			std::vector< std::shared_ptr< Sound::PlayingSample > > voices;
+			for (uint32_t v = 0; v < voice_count; ++v) {
+				voices.emplace_back(Sound::loop(sample, 1.0f / voice_count, 0.0f, 48000.0f / rate));
+				//spread voices through the sample, so they aren't all silent at once:
+				Sound::lock();
+				voices.back()->i = uint32_t(uint64_t(sample.size()) * v / voice_count);
+				Sound::unlock();
+			}
+			auto before = std::chrono::high_resolution_clock::now();
+			for (uint32_t b = 0; b < blocks; ++b) {
+				Sound::render(block.data(), BlockFrames);
+			}
+			costs[t] = since(before) * 1.0e6f / (voice_count * mixed_seconds);
+
+			Sound::MixTimes after_times = Sound::mix_times();
+			uint64_t mixed = after_times.voices - before_times.voices;
+			uint64_t skipped = after_times.silent_voices - before_times.silent_voices;
+
+			for (auto &voice : voices) {
+				voice->stop(0.0f);
+			}
+			Sound::render(block.data(), BlockFrames); //(removes stopped voices)
+			Sound::collect(); //(...and frees them)
+
+			std::cout << "  " << (t == 0 ? "mix everything:  " : "skip silence:    ") << costs[t] << " us per voice per second mixed ("
+			          << (mixed ? 100.0f * skipped / mixed : 0.0f) << "% of voice-blocks skipped)\n";
+		}
+		std::cout << "  saved " << (costs[0] > 0.0f ? 100.0f * (1.0f - costs[1] / costs[0]) : 0.0f) << "% of mixing time" << std::endl;
+		return 0;
+	}
+
+	struct Encoding {
+		Sound::Sample::Encoding encoding;
+		char const *name;
+	};
+	Encoding const encodings[] = {
+		{ Sound::Sample::Encoding::Float, "Float" },
+		{ Sound::Sample::Encoding::PCM16, "PCM16" },
+		{ Sound::Sample::Encoding::Block8, "Block8" },
+	};
+
+	std::cout << filename << ": " << data.size() << " values at " << rate << " Hz; mixing " << voice_count << " voices for " << mixed_seconds << " s.\n";
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  encoding   MB/minute   SNR (dB)   us per voice per second mixed (own rate / resampled)\n";
+	for (auto const &encoding : encodings) {
+		Sound::Sample sample(data, rate, encoding.encoding);
+
+		float minutes = data.size() / float(rate) / 60.0f;
+		float mb_per_minute = sample.memory() / (1024.0f * 1024.0f) / minutes;
+
+		double signal = 0.0, error = 0.0;
+		for (uint32_t i = 0; i < data.size(); ++i) {
+			signal += double(data[i]) * data[i];
+			double e = double(sample.at(i)) - data[i];
+			error += e * e;
+		}
+		double snr = (error > 0.0 ? 10.0 * std::log10(signal / error) : std::numeric_limits< double >::infinity());
+
+		//time mixing at 1x (plain conversion) and slightly off (resampling):
+		float costs[2];
+		float const rates[2] = { 48000.0f / rate, 1.06f * 48000.0f / rate };
+		for (uint32_t r = 0; r < 2; ++r) {
+			std::vector< std::shared_ptr< Sound::PlayingSample > > voices;
+			for (uint32_t v = 0; v < voice_count; ++v) {
+				float pan = (voice_count > 1 ? 2.0f * v / (voice_count - 1) - 1.0f : 0.0f);
+				voices.emplace_back(Sound::loop(sample, 1.0f / voice_count, pan, rates[r]));
+			}
+			for (uint32_t b = 0; b < 10; ++b) { //warm up
+				Sound::render(block.data(), BlockFrames);
+			}
+			auto before = std::chrono::high_resolution_clock::now();
+			for (uint32_t b = 0; b < blocks; ++b) {
+				Sound::render(block.data(), BlockFrames);
+			}
+			costs[r] = since(before) * 1.0e6f / (voice_count * mixed_seconds);
+
+			for (auto &voice : voices) {
+				voice->stop(0.0f);
+			}
+			Sound::render(block.data(), BlockFrames); //(removes stopped voices)
+			Sound::collect(); //(...and frees them)
+		}
+
+		std::cout << "  " << std::left << std::setw(9) << encoding.name << std::right
+		          << std::setw(11) << mb_per_minute
+		          << std::setw(11) << snr
+		          << "   " << costs[0] << " / " << costs[1] << "\n";
+	}
+	std::cout.flush();
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+//Benchmark for BVH.hpp: builds a BVH for each mesh in some '.pnct' files
+// and measures ray cast + overlap query throughput (no window or OpenGL needed).
+//
+//Usage:
+//	bench-bvh [--rays N] [path/to/meshes.pnct ...]
+// (defaults to ground.pnct and hexapod.pnct next to the executable)
+
+#include "BVH.hpp"
+#include "read_write_chunk.hpp"
+#include "data_path.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	//vertex format of '.pnct' files (same as Mesh.cpp):
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::u8vec4 Color;
+		glm::vec2 TexCoord;
+	};
+	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_begin, vertex_end;
+	};
+	static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+
+	//seconds since 'before':
+	float since(std::chrono::high_resolution_clock::time_point before) {
+		return std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - before).count();
+	}
+
+	//closest hit by testing every triangle (used to check BVH results):
+	float brute_force_ray(std::vector< glm::vec3 > const &positions, Ray const &ray) {
+		float best = std::numeric_limits< float >::infinity();
+		for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+			glm::vec3 e1 = positions[i+1] - positions[i];
+			glm::vec3 e2 = positions[i+2] - positions[i];
+			glm::vec3 p = glm::cross(ray.direction, e2);
+			float det = glm::dot(e1, p);
+			if (det == 0.0f) continue;
+			glm::vec3 s = ray.origin - positions[i];
+			float u = glm::dot(s, p) / det;
+			glm::vec3 q = glm::cross(s, e1);
+			float v = glm::dot(ray.direction, q) / det;
+			float t = glm::dot(e2, q) / det;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f) best = std::min(best, t);
+		}
+		return best;
+	}
+
+	void bench_mesh(std::string const &name, std::vector< glm::vec3 > const &positions, uint32_t ray_count) {
+		auto before = std::chrono::high_resolution_clock::now();
+		BVH bvh(positions);
+		float build_time = since(before);
+
+		glm::vec3 min = bvh.nodes[0].min;
+		glm::vec3 max = bvh.nodes[0].max;
+		glm::vec3 center = 0.5f * (min + max);
+		float radius = 0.5f * glm::length(max - min);
+
+		//rays from a sphere around the mesh toward random points inside its bounds:
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > unit(0.0f, 1.0f);
+		auto random_in_box = [&]() {
+			return min + (max - min) * glm::vec3(unit(mt), unit(mt), unit(mt));
+		};
+		auto random_on_sphere = [&]() {
+			float z = 2.0f * unit(mt) - 1.0f;
+			float a = 6.2831853f * unit(mt);
+			float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+			return glm::vec3(r * std::cos(a), r * std::sin(a), z);
+		};
+		std::vector< Ray > rays(ray_count);
+		for (auto &ray : rays) {
+			ray.origin = center + 2.0f * radius * random_on_sphere();
+			ray.direction = random_in_box() - ray.origin;
+		}
+
+		//correctness check against brute force on a few rays:
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < std::min(ray_count, 200u); ++i) {
+			BVH::RayHit hit;
+			float expected = brute_force_ray(positions, rays[i]);
+			float got = (bvh.ray_cast(rays[i].origin, rays[i].direction, std::numeric_limits< float >::infinity(), &hit) ? hit.t : std::numeric_limits< float >::infinity());
+			if (!(got == expected || std::abs(got - expected) <= 1e-4f * std::max(1.0f, expected))) mismatches += 1;
+		}
+
+		//ray casts (local space):
+		uint32_t hits = 0;
+		before = std::chrono::high_resolution_clock::now();
+		for (auto const &ray : rays) {
+			BVH::RayHit hit;
+			if (bvh.ray_cast(ray.origin, ray.direction, std::numeric_limits< float >::infinity(), &hit)) hits += 1;
+		}
+		float ray_time = since(before);
+
+		//ray casts (world space, through a rotated + non-uniformly scaled transform):
+		Scene::Transform transform;
+		transform.position = glm::vec3(1.0f, -2.0f, 0.5f);
+		transform.rotation = glm::angleAxis(0.7f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+		transform.scale = glm::vec3(1.5f, 0.75f, 2.0f);
+		glm::mat4x3 world_from_local = transform.make_world_from_local();
+		std::vector< Ray > world_rays(rays.size());
+		for (size_t i = 0; i < rays.size(); ++i) {
+			world_rays[i].origin = world_from_local * glm::vec4(rays[i].origin, 1.0f);
+			world_rays[i].direction = world_from_local * glm::vec4(rays[i].direction, 0.0f);
+		}
+		uint32_t world_hits = 0;
+		before = std::chrono::high_resolution_clock::now();
+		for (auto const &ray : world_rays) {
+			if (bvh.ray_cast(transform, ray.origin, ray.direction)) world_hits += 1;
+		}
+		float world_ray_time = since(before);
+
+		//sphere + box overlaps (sized at a few percent of the mesh):
+		uint32_t query_count = ray_count;
+		std::vector< glm::vec3 > centers(query_count);
+		for (auto &c : centers) c = random_in_box();
+		float query_radius = 0.05f * radius;
+
+		uint32_t sphere_hits = 0;
+		before = std::chrono::high_resolution_clock::now();
+		for (auto const &c : centers) {
+			if (bvh.overlaps_sphere(c, query_radius)) sphere_hits += 1;
+		}
+		float sphere_time = since(before);
+
+		uint32_t box_hits = 0;
+		before = std::chrono::high_resolution_clock::now();
+		for (auto const &c : centers) {
+			if (bvh.overlaps_box(c - glm::vec3(query_radius), c + glm::vec3(query_radius))) box_hits += 1;
+		}
+		float box_time = since(before);
+
+		auto rate = [](uint32_t count, float seconds) {
+			return (seconds > 0.0f ? count / seconds / 1.0e6f : 0.0f);
+		};
+		std::cout << "  '" << name << "': " << positions.size() / 3 << " triangles, " << bvh.nodes.size() << " nodes, built in " << build_time * 1000.0f << " ms\n";
+		std::cout << "    rays:        " << rate(ray_count, ray_time) << " M/s (" << (100.0f * hits / ray_count) << "% hit)\n";
+		std::cout << "    world rays:  " << rate(ray_count, world_ray_time) << " M/s (" << (100.0f * world_hits / ray_count) << "% hit)\n";
+		std::cout << "    spheres:     " << rate(query_count, sphere_time) << " M/s (" << (100.0f * sphere_hits / query_count) << "% overlap)\n";
+		std::cout << "    boxes:       " << rate(query_count, box_time) << " M/s (" << (100.0f * box_hits / query_count) << "% overlap)\n";
+		if (mismatches) {
+			std::cout << "    WARNING: " << mismatches << " ray(s) disagreed with brute force!\n";
+		}
+		std::cout.flush();
+	}
+
+	void bench_file(std::string const &filename, uint32_t ray_count) {
+		std::ifstream file(filename, std::ios::binary);
+		if (!file) throw std::runtime_error("Failed to open '" + filename + "'.");
+
+		std::vector< Vertex > data;
+		read_chunk(file, "pnct", &data);
+		std::vector< char > strings;
+		read_chunk(file, "str0", &strings);
+		std::vector< IndexEntry > index;
+		read_chunk(file, "idx0", &index);
+
+		std::cout << filename << ":" << std::endl;
+		for (auto const &entry : index) {
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+				throw std::runtime_error("index entry has out-of-range name begin/end");
+			}
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= data.size())) {
+				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			}
+			std::string name(strings.data() + entry.name_begin, strings.data() + entry.name_end);
+			std::vector< glm::vec3 > positions;
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+				positions.emplace_back(data[v].Position);
+			}
+			positions.resize(positions.size() / 3 * 3); //(drop any partial triangle)
+			if (positions.empty()) continue;
+			bench_mesh(name, positions, ray_count);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t ray_count = 1000000;
+	std::vector< std::string > files;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--rays" && argi + 1 < argc) {
+			argi += 1;
+			ray_count = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg.size() > 0 && arg[0] != '-') {
+			files.emplace_back(arg);
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--rays N] [path/to/meshes.pnct ...]" << std::endl;
+			return 1;
+		}
+	}
+	if (files.empty()) {
+		files.emplace_back(data_path("ground.pnct"));
+		files.emplace_back(data_path("hexapod.pnct"));
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	try {
+		for (auto const &filename : files) {
+			bench_file(filename, ray_count);
+		}
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
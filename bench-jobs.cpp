@@ -0,0 +1,101 @@
+//Benchmark for Jobs.hpp: evaluates world transforms for a large scene with
+// Scene::make_world_from_locals (a Jobs::parallel_for), using 1 to N threads,
+// and reports speedup + parallel efficiency (no window or OpenGL needed).
+//
+//Usage:
+//	bench-jobs [--transforms N] [--depth N] [--reps N] [--threads N]
+
+#include "Jobs.hpp"
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv) {
+	uint32_t transform_count = 200000;
+	uint32_t depth = 4;
+	uint32_t reps = 20;
+	uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--transforms" && argi + 1 < argc) {
+			argi += 1;
+			transform_count = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--depth" && argi + 1 < argc) {
+			argi += 1;
+			depth = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--reps" && argi + 1 < argc) {
+			argi += 1;
+			reps = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--threads" && argi + 1 < argc) {
+			argi += 1;
+			max_threads = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--transforms N] [--depth N] [--reps N] [--threads N]" << std::endl;
+			return 1;
+		}
+	}
+
+	//a scene made of chains of 'depth' transforms, each a child of the one before:
+	std::mt19937 mt(0x15466);
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+	Scene scene;
+	std::vector< Scene::Transform const * > transforms;
+	transforms.reserve(transform_count);
+	Scene::Transform *parent = nullptr;
+	for (uint32_t i = 0; i < transform_count; ++i) {
+		scene.transforms.emplace_back();
+		Scene::Transform *transform = &scene.transforms.back();
+		transform->position = glm::vec3(unit(mt), unit(mt), unit(mt)) * 10.0f;
+		transform->rotation = glm::normalize(glm::quat(1.0f, unit(mt), unit(mt), unit(mt)));
+		transform->scale = glm::vec3(1.0f + 0.1f * unit(mt));
+		transform->parent = (i % depth == 0 ? nullptr : parent);
+		parent = transform;
+		transforms.emplace_back(transform);
+	}
+
+	std::vector< glm::mat4x3 > reference;
+	std::vector< glm::mat4x3 > results;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << transform_count << " transforms (chains of " << depth << "), median of " << reps << " evaluations:\n";
+	std::cout << "  threads        ms   speedup   efficiency\n";
+
+	float single_ms = 0.0f;
+	for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+		//(this thread works too, so 'threads' threads means 'threads - 1' workers)
+		if (threads > 1) Jobs::init(threads - 1);
+
+		std::vector< float > times;
+		for (uint32_t rep = 0; rep < reps; ++rep) {
+			auto before = std::chrono::high_resolution_clock::now();
+			Scene::make_world_from_locals(transforms, &results);
+			times.emplace_back(std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - before).count());
+		}
+		if (threads > 1) Jobs::shutdown();
+
+		std::sort(times.begin(), times.end());
+		float ms = times[times.size() / 2];
+		if (threads == 1) {
+			single_ms = ms;
+			reference = results;
+		} else if (results != reference) {
+			std::cout << "  WARNING: results with " << threads << " threads differ from single-threaded results!\n";
+		}
+		float speedup = (ms > 0.0f ? single_ms / ms : 0.0f);
+		std::cout << "  " << std::setw(7) << threads << "  " << std::setw(8) << ms << "  " << std::setw(7) << speedup << "x  " << std::setw(9) << 100.0f * speedup / threads << "%\n";
+		std::cout.flush();
+	}
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+//Benchmark for Scene::SpatialIndex: fills a scene with lots of small drawables,
+// moves some of them every "frame", and times index updates + queries
+// (no window or OpenGL needed).
+//
+//Usage:
+//	bench-spatial [--objects N] [--moving N] [--frames N]
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	//seconds since 'before':
+	float since(std::chrono::high_resolution_clock::time_point before) {
+		return std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - before).count();
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t object_count = 100000;
+	uint32_t moving_count = 1000;
+	uint32_t frame_count = 100;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--objects" && argi + 1 < argc) {
+			argi += 1;
+			object_count = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--moving" && argi + 1 < argc) {
+			argi += 1;
+			moving_count = uint32_t(std::max(0, std::atoi(argv[argi])));
+		} else if (arg == "--frames" && argi + 1 < argc) {
+			argi += 1;
+			frame_count = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--objects N] [--moving N] [--frames N]" << std::endl;
+			return 1;
+		}
+	}
+	moving_count = std::min(moving_count, object_count);
+
+	//objects spread over a square world with about one object per (default-sized) grid cell:
+	float world_size = std::sqrt(float(object_count)) * 4.0f;
+
+	std::mt19937 mt(0x15466);
+	std::uniform_real_distribution< float > coord(-0.5f * world_size, 0.5f * world_size);
+	std::uniform_real_distribution< float > step(-0.5f, 0.5f);
+
+	Scene scene;
+	std::vector< Scene::Transform * > transforms;
+	transforms.reserve(object_count);
+	for (uint32_t i = 0; i < object_count; ++i) {
+		scene.transforms.emplace_back();
+		Scene::Transform *transform = &scene.transforms.back();
+		transform->position = glm::vec3(coord(mt), coord(mt), 0.0f);
+		transforms.emplace_back(transform);
+
+		scene.drawables.emplace_back(transform);
+		scene.drawables.back().min = glm::vec3(-0.5f);
+		scene.drawables.back().max = glm::vec3( 0.5f);
+	}
+
+	auto before = std::chrono::high_resolution_clock::now();
+	scene.spatial_index.build(scene);
+	float build_time = since(before);
+
+	std::vector< Scene::Drawable * > results;
+	float update_time = 0.0f;
+	float radius_time = 0.0f;
+	float frustum_time = 0.0f;
+	size_t radius_results = 0;
+	size_t frustum_results = 0;
+	constexpr uint32_t const RadiusQueries = 100;
+
+	glm::mat4 clip_from_world = glm::infinitePerspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f)
+		* glm::lookAt(glm::vec3(0.0f, -20.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	for (uint32_t frame = 0; frame < frame_count; ++frame) {
+		//move a different (contiguous) batch of objects each frame:
+		for (uint32_t i = 0; i < moving_count; ++i) {
+			Scene::Transform *transform = transforms[(frame * moving_count + i) % object_count];
+			transform->position += glm::vec3(step(mt), step(mt), 0.0f);
+			scene.spatial_index.moved(transform);
+		}
+		before = std::chrono::high_resolution_clock::now();
+		scene.spatial_index.update();
+		update_time += since(before);
+
+		before = std::chrono::high_resolution_clock::now();
+		for (uint32_t q = 0; q < RadiusQueries; ++q) {
+			results.clear();
+			scene.spatial_index.query_radius(glm::vec3(coord(mt), coord(mt), 0.0f), 5.0f, &results);
+			radius_results += results.size();
+		}
+		radius_time += since(before);
+
+		before = std::chrono::high_resolution_clock::now();
+		results.clear();
+		scene.spatial_index.query_frustum(clip_from_world, &results);
+		frustum_results += results.size();
+		frustum_time += since(before);
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	size_t occupied = std::count_if(scene.spatial_index.cells.begin(), scene.spatial_index.cells.end(), [](auto const &cell){ return !cell.second.empty(); });
+	std::cout << object_count << " objects (" << moving_count << " moving per frame), " << occupied << " occupied cells, " << scene.spatial_index.oversized.size() << " oversized.\n";
+	std::cout << "  build:          " << build_time * 1000.0f << " ms\n";
+	std::cout << "  update:         " << update_time * 1000.0f / frame_count << " ms/frame (" << (moving_count ? update_time * 1.0e9f / (float(frame_count) * moving_count) : 0.0f) << " ns per moved object)\n";
+	std::cout << "  radius query:   " << radius_time * 1.0e6f / (float(frame_count) * RadiusQueries) << " us (" << float(radius_results) / (float(frame_count) * RadiusQueries) << " results on average)\n";
+	std::cout << "  frustum query:  " << frustum_time * 1000.0f / frame_count << " ms (" << float(frustum_results) / frame_count << " results on average)\n";
+	std::cout.flush();
+
+	return 0;
+}
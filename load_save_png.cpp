@@ -12,7 +12,7 @@
 using std::vector;
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
-void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
+void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin, CompressionLevel compression);
 
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
 	assert(size);
@@ -26,9 +26,9 @@ void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 >
 	}
 }
 
-void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin) {
+void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin, CompressionLevel compression) {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	save_png(file, size.x, size.y, data, origin);
+	save_png(file, size.x, size.y, data, origin, compression);
 }
 
 
@@ -128,7 +128,7 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 }
 
 
-void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin) {
+void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin, CompressionLevel compression) {
 //After the libpng example.c
 	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 
@@ -155,6 +155,12 @@ void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8
 	//Not needed with custom read/write functions: png_init_io(png_ptr, fp);
 	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
+	if (compression == FastCompression) {
+		//default is zlib level 6 + adaptive filtering (tries all five filters per row); this is much cheaper:
+		png_set_compression_level(png_ptr, 1);
+		png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+	}
+
 	png_write_info(png_ptr, info_ptr);
 	//png_set_swap_alpha(png_ptr) // might need?
 	vector< png_bytep > row_pointers(height);
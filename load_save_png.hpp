@@ -15,6 +15,13 @@ enum OriginLocation {
 	UpperLeftOrigin,
 };
 
+//FastCompression trades file size for encoding speed (low zlib level, single simple filter):
+// (useful for frame capture, where encoding needs to keep up with the frame rate)
+enum CompressionLevel {
+	DefaultCompression,
+	FastCompression,
+};
+
 //NOTE: load_png will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
-void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
+void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin, CompressionLevel compression = DefaultCompression);
@@ -8,7 +8,7 @@
 
 constexpr uint32_t AUDIO_RATE = 48000;
 
-void load_wav(std::string const &filename, std::vector< float > *data_) {
+void load_wav(std::string const &filename, std::vector< float > *data_, uint32_t *rate) {
 	assert(data_);
 	auto &data = *data_;
 
@@ -19,11 +19,13 @@ void load_wav(std::string const &filename, std::vector< float > *data_) {
 	if (!SDL_LoadWAV(filename.c_str(), &audio_spec, &audio_buf, &audio_len)) {
 		throw std::runtime_error("Failed to load WAV file '" + filename + "'; SDL says \"" + std::string(SDL_GetError()) + "\"");
 	}
-	SDL_AudioSpec out_spec{ .format=SDL_AUDIO_F32, .channels=1, .freq=AUDIO_RATE };
+	//(the mixer resamples on the fly, so callers that can handle it get the native rate):
+	SDL_AudioSpec out_spec{ .format=SDL_AUDIO_F32, .channels=1, .freq=(rate ? audio_spec.freq : int(AUDIO_RATE)) };
+	if (rate) *rate = uint32_t(audio_spec.freq);
 	if (audio_spec.format != out_spec.format || audio_spec.channels != out_spec.channels || audio_spec.freq != out_spec.freq) {
 		Uint8 *out_buf = NULL;
 		int out_len = 0;
-		std::cout << "WAV file '" + filename + "' didn't load as " + std::to_string(AUDIO_RATE) + " Hz, float32, mono; converting." << std::endl;
+		std::cout << "WAV file '" + filename + "' didn't load as " + std::to_string(out_spec.freq) + " Hz, float32, mono; converting." << std::endl;
 
 		if (!SDL_ConvertAudioSamples(&audio_spec, audio_buf, audio_len, &out_spec, &out_buf, &out_len)) {
 			//shouldn't happen, but if it does treat as fatal
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 #include <vector>
 
-//Load a WAV file as 48kHz floating-point mono; throws on error:
-void load_wav(std::string const &filename, std::vector< float > *data);
+//Load a WAV file as floating-point mono; throws on error.
+// if 'rate' is supplied, keeps the file's sampling rate and stores it there;
+// otherwise converts to 48kHz:
+void load_wav(std::string const &filename, std::vector< float > *data, uint32_t *rate = nullptr);
@@ -6,15 +6,40 @@
 
 //For asset loading:
 #include "Load.hpp"
+#include "Snapshot.hpp"
 
 //For sound init:
 #include "Sound.hpp"
 
+//For texture streaming:
+#include "Textures.hpp"
+
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
-//for screenshots:
-#include "load_save_png.hpp"
+//for screenshots + frame capture:
+#include "Capture.hpp"
+
+//for reloading edited assets while running:
+#include "HotReload.hpp"
+
+//for --bench:
+#include "Bench.hpp"
+
+//for --record / --replay:
+#include "Replay.hpp"
+
+//for the shared worker threads:
+#include "Jobs.hpp"
+
+//for per-frame transient memory + allocation counts:
+#include "FrameArena.hpp"
+
+//for checking the audio mixer for allocations and blocking:
+#include "RealtimeCheck.hpp"
+
+//for the default audio cache location:
+#include "data_path.hpp"
 
 //Includes for libSDL:
 #include <SDL3/SDL.h>
@@ -22,10 +47,19 @@
 
 //...and for c++ standard library functions:
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <functional>
+#include <vector>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -46,8 +80,89 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//used to report time-to-first-frame:
+	auto launch_time = std::chrono::high_resolution_clock::now();
+
+	//------------  command line ------------
+
+	std::string snapshot_file; //if set, startup snapshot used to skip asset parsing
+	Capture::Sequence capture_sequence; //settings for continuous capture (toggled with shift + print screen)
+	bool hot_reload = false; //if set, watch asset files and reload them when they change
+	bool render_thread = false; //if set, draw + present on a separate thread from events + updates
+	uint32_t bench_frames = 0; //if set, run this many frames headless with scripted input, print timings, and exit
+	std::string record_file; //if set, record input + timing + random seeds here
+	std::string replay_file; //if set, play back input + timing + random seeds from here (as fast as possible)
+	uint32_t job_workers = 0; //worker threads for Jobs (0 = one less than the number of hardware threads)
+	std::string audio_cache = data_path("audio-cache"); //decoded samples are cached here ("" = don't cache)
+	uint32_t mix_threads = 1; //threads mixing audio (more than one also mixes ahead of the device)
+	float audio_latency = 0.02f; //seconds of audio output to keep buffered
+	uint32_t audio_block = 256; //frames of audio mixed at a time
+	bool audio_rt_check = false; //if set, report allocations and blocking locks in the audio mixer
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--snapshot" && argi + 1 < argc) {
+			argi += 1;
+			snapshot_file = argv[argi];
+		} else if (arg == "--capture-every" && argi + 1 < argc) {
+			argi += 1;
+			capture_sequence.every = std::max(1, std::atoi(argv[argi]));
+		} else if (arg == "--capture-raw") {
+			capture_sequence.raw = true;
+		} else if (arg == "--hot-reload") {
+			hot_reload = true;
+		} else if (arg == "--tick-rate" && argi + 1 < argc) {
+			argi += 1;
+			Mode::tick_rate = std::max(0.0f, float(std::atof(argv[argi])));
+		} else if (arg == "--max-ticks" && argi + 1 < argc) {
+			argi += 1;
+			Mode::max_ticks = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--render-thread") {
+			render_thread = true;
+		} else if (arg == "--bench" && argi + 1 < argc) {
+			argi += 1;
+			bench_frames = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--jobs" && argi + 1 < argc) {
+			argi += 1;
+			job_workers = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--record" && argi + 1 < argc) {
+			argi += 1;
+			record_file = argv[argi];
+		} else if (arg == "--replay" && argi + 1 < argc) {
+			argi += 1;
+			replay_file = argv[argi];
+		} else if (arg == "--audio-cache" && argi + 1 < argc) {
+			argi += 1;
+			audio_cache = argv[argi];
+		} else if (arg == "--no-audio-cache") {
+			audio_cache = "";
+		} else if (arg == "--audio-latency" && argi + 1 < argc) {
+			argi += 1;
+			audio_latency = std::max(0.0f, float(std::atof(argv[argi]))) / 1000.0f;
+		} else if (arg == "--audio-block" && argi + 1 < argc) {
+			argi += 1;
+			audio_block = uint32_t(std::max(32, std::atoi(argv[argi])));
+		} else if (arg == "--mix-threads" && argi + 1 < argc) {
+			argi += 1;
+			mix_threads = uint32_t(std::max(1, std::atoi(argv[argi])));
+		} else if (arg == "--audio-rt-check") {
+			audio_rt_check = true;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--snapshot <file.snapshot>] [--capture-every <N>] [--capture-raw] [--hot-reload] [--tick-rate <Hz>] [--max-ticks <N>] [--render-thread] [--bench <frames>] [--record <file> | --replay <file>] [--jobs <N>] [--audio-cache <dir> | --no-audio-cache] [--mix-threads <N>] [--audio-latency <ms>] [--audio-block <frames>] [--audio-rt-check]" << std::endl;
+			return 1;
+		}
+	}
+
 	//------------  initialization ------------
 
+	if (bench_frames) {
+		//benchmarks run without a display where possible (EGL pbuffer via the "offscreen" driver) and with silent audio:
+		// (SDL_VIDEO_DRIVER / SDL_AUDIO_DRIVER environment variables still take precedence)
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+		SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+		render_thread = false;
+	}
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -72,6 +187,7 @@ int main(int argc, char **argv) {
 		SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_HIGH_PIXEL_DENSITY //uncomment for full resolution on high-DPI screens
+		| (bench_frames ? SDL_WINDOW_HIDDEN : 0)
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -95,7 +211,10 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (!SDL_GL_SetSwapInterval(-1)) {
+	if (bench_frames || replay_file != "") {
+		//(...except when benchmarking or replaying, which want to see the crazy FPS)
+		SDL_GL_SetSwapInterval(0);
+	} else if (!SDL_GL_SetSwapInterval(-1)) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (!SDL_GL_SetSwapInterval(1)) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -109,10 +228,38 @@ int main(int argc, char **argv) {
 	//SDL_ShowCursor(SDL_DISABLE);
 
 	//------------ init sound --------------
-	Sound::init();
+	RealtimeCheck::enable(audio_rt_check);
+	Sound::set_latency(audio_latency, audio_block);
+	Sound::init(mix_threads);
+
+	//------------ init worker threads --------------
+	Jobs::init(job_workers);
+	std::cout << "Started " << Jobs::worker_count() << " job worker threads." << std::endl;
+
+	//------------ init texture streaming + frame capture --------------
+	Textures::init();
+	Capture::init();
 
 	//------------ load assets --------------
+	//(loaders register watches as they go, so hot reloading must be enabled first)
+	if (hot_reload) HotReload::init();
+
+	auto load_start = std::chrono::high_resolution_clock::now();
+	Sound::set_cache_directory(audio_cache);
+	if (snapshot_file != "") Snapshot::begin(snapshot_file);
 	call_load_functions();
+	if (snapshot_file != "") Snapshot::finish();
+	std::cout << "Loaded assets in " << std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - load_start).count() << " ms";
+	Sound::LoadTimes sound_load = Sound::load_times();
+	if (sound_load.samples) {
+		std::cout << " (" << sound_load.seconds * 1000.0 << " ms loading " << sound_load.samples << " sounds, " << sound_load.cached << " from the audio cache)";
+	}
+	std::cout << "." << std::endl;
+
+	//------------ start recording / replaying --------------
+	//(before creating the game mode, since it draws a random seed)
+	if (replay_file != "") Replay::play(replay_file);
+	else if (record_file != "") Replay::record(record_file);
 
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< PlayMode >());
@@ -130,18 +277,199 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GetWindowSizeInPixels(Mode::window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);
 	};
 	on_resize();
 
+	//run the benchmark instead of the main loop:
+	if (bench_frames) {
+		Bench::run(bench_frames, drawable_size);
+		Mode::set_current(nullptr);
+	}
+
+	//fixed-step simulation bookkeeping:
+	float tick_accumulator = 0.0f; //simulation time not yet stepped
+	float dropped_time = 0.0f; //simulation time skipped because fixed updates fell behind
+	uint32_t dropped_frames = 0; //frames on which time was skipped
+
+	//everything needed to put one frame on screen, handed from the update loop to whichever thread owns the OpenGL context:
+	struct RenderFrame {
+		std::vector< std::function< void() > > commands; //run first (e.g., capture requests, reloading assets)
+		std::function< void() > draw; //(if empty, only 'commands' are run and nothing is presented)
+		glm::uvec2 drawable_size = glm::uvec2(0);
+		uint64_t input_ns = 0; //timestamp (SDL_GetTicksNS) of the earliest input event handled for this frame, or 0 if none
+	};
+
+	//frame throughput + input-to-present latency (only touched by the thread presenting frames):
+	struct {
+		uint32_t frames = 0;
+		std::chrono::high_resolution_clock::time_point first, last;
+		uint32_t input_frames = 0;
+		double input_latency_total = 0.0; //seconds
+		double input_latency_max = 0.0; //seconds
+	} present_stats;
+
+	//heap allocations per frame on one thread (after some warm-up frames, when containers have reached their steady-state sizes):
+	constexpr uint32_t WarmupFrames = 60;
+	struct AllocationStats {
+		uint64_t last = 0; //FrameArena::heap_allocations() at the end of the previous frame
+		uint32_t frames = 0;
+		uint32_t counted = 0, allocation_free = 0;
+		uint64_t total = 0, max = 0;
+		//call from the counted thread at the end of each frame:
+		void frame() {
+			uint64_t now = FrameArena::heap_allocations();
+			frames += 1;
+			if (frames > WarmupFrames) {
+				uint64_t count = now - last;
+				counted += 1;
+				total += count;
+				max = std::max(max, count);
+				if (count == 0) allocation_free += 1;
+			}
+			last = now;
+		}
+		void report(std::string const &thread) const {
+			if (counted == 0) return;
+			std::cout << "Heap allocations per frame on " << thread << ": " << double(total) / counted << " average, " << max << " max; "
+				<< allocation_free << " of " << counted << " frames (after " << WarmupFrames << " warm-up frames) allocation-free." << std::endl;
+		}
+	};
+	AllocationStats update_allocations, render_allocations;
+	size_t render_arena_high_water = 0;
+
+	glm::uvec2 viewport_size = glm::uvec2(0); //size last passed to glViewport
+
+	//run a frame's commands, then draw + present it (with the OpenGL context current):
+	auto present = [&](RenderFrame &frame) {
+		for (auto const &command : frame.commands) {
+			command();
+		}
+
+		//run any jobs that need the OpenGL context:
+		Jobs::update();
+
+		if (!frame.draw) return;
+
+		if (frame.drawable_size != viewport_size) {
+			viewport_size = frame.drawable_size;
+			glViewport(0, 0, viewport_size.x, viewport_size.y);
+		}
+
+		//upload any textures that finished decoding:
+		Textures::update();
+
+		frame.draw();
+
+		//start read-back if this frame is being captured:
+		Capture::frame(frame.drawable_size);
+
+		//Wait until the recently-drawn frame is shown:
+		SDL_GL_SwapWindow(Mode::window);
+
+		auto now = std::chrono::high_resolution_clock::now();
+		if (present_stats.frames == 0) present_stats.first = now;
+		present_stats.last = now;
+		present_stats.frames += 1;
+		if (frame.input_ns != 0) {
+			uint64_t now_ns = SDL_GetTicksNS();
+			double latency = (now_ns > frame.input_ns ? double(now_ns - frame.input_ns) * 1.0e-9 : 0.0);
+			present_stats.input_frames += 1;
+			present_stats.input_latency_total += latency;
+			present_stats.input_latency_max = std::max(present_stats.input_latency_max, latency);
+		}
+
+		if (present_stats.frames == 1) {
+			float ms = std::chrono::duration< float, std::milli >(now - launch_time).count();
+			std::cout << "First frame presented " << ms << " ms after launch" << (snapshot_file != "" ? " (using snapshot)." : ".") << std::endl;
+		}
+	};
+
+	//render thread (if used) takes frames from a one-frame mailbox, so it draws frame N
+	// while the update loop processes events + updates for frame N+1:
+	std::mutex render_mutex;
+	std::condition_variable render_cv;
+	std::optional< RenderFrame > render_mailbox; //next frame to present
+	bool render_busy = false; //is the render thread running a frame right now?
+	bool render_quit = false; //should the render thread exit once the mailbox is empty?
+	std::thread renderer;
+	//mode that prepared the frames handed to the render thread, kept alive until they are drawn:
+	// (prepared frames point into their mode, and Mode::current may switch or be cleared at any time)
+	std::shared_ptr< Mode > prepared_mode;
+
+	//hand a frame to the render thread (waits for the mailbox to be empty):
+	auto submit = [&](RenderFrame &&frame) {
+		std::unique_lock< std::mutex > lock(render_mutex);
+		render_cv.wait(lock, [&](){ return !render_mailbox; });
+		render_mailbox = std::move(frame);
+		render_cv.notify_all();
+	};
+	//wait until the render thread has picked up the frame in the mailbox:
+	auto wait_mailbox = [&]() {
+		std::unique_lock< std::mutex > lock(render_mutex);
+		render_cv.wait(lock, [&](){ return !render_mailbox; });
+	};
+	//wait until the render thread has finished everything it was given:
+	auto wait_idle = [&]() {
+		std::unique_lock< std::mutex > lock(render_mutex);
+		render_cv.wait(lock, [&](){ return !render_mailbox && !render_busy; });
+	};
+
+	if (render_thread) {
+		//the OpenGL context can only be current on one thread at a time, so hand it over:
+		SDL_GL_MakeCurrent(Mode::window, NULL);
+		renderer = std::thread([&](){
+			if (!SDL_GL_MakeCurrent(Mode::window, context)) {
+				std::cerr << "Error making OpenGL context current on render thread: " << SDL_GetError() << std::endl;
+			}
+			Jobs::set_main_thread(); //(main-thread jobs are about having the OpenGL context)
+			std::unique_lock< std::mutex > lock(render_mutex);
+			while (true) {
+				render_cv.wait(lock, [&](){ return render_mailbox || render_quit; });
+				if (!render_mailbox) break;
+				RenderFrame frame = std::move(*render_mailbox);
+				render_mailbox.reset();
+				render_busy = true;
+				render_cv.notify_all();
+				lock.unlock();
+
+				//(this thread's transient memory is only used by the frame it draws)
+				FrameArena::reset();
+				present(frame);
+				render_allocations.frame();
+
+				lock.lock();
+				render_busy = false;
+				render_cv.notify_all();
+			}
+			render_arena_high_water = FrameArena::high_water();
+			SDL_GL_MakeCurrent(Mode::window, NULL);
+		});
+	}
+
+	//work for the next frame that must happen where the OpenGL context is:
+	std::vector< std::function< void() > > commands;
+	uint64_t input_ns = 0;
+
+	//audio problems are checked for (and logged) about once a second:
+	auto audio_check_time = std::chrono::steady_clock::now();
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(last frame's transient memory is no longer needed)
+		update_allocations.frame();
+		FrameArena::reset();
+		Sound::collect(); //(free sounds that finished playing)
+
 		{ //(1) process any events that are pending
-			static SDL_Event evt;
-			while (SDL_PollEvent(&evt)) {
+			auto handle = [&](SDL_Event const &evt) {
+				//remember when the oldest input behind this frame happened (for latency stats):
+				if (evt.type == SDL_EVENT_KEY_DOWN || evt.type == SDL_EVENT_KEY_UP
+				 || evt.type == SDL_EVENT_MOUSE_MOTION || evt.type == SDL_EVENT_MOUSE_BUTTON_DOWN || evt.type == SDL_EVENT_MOUSE_BUTTON_UP) {
+					if (input_ns == 0 || evt.common.timestamp < input_ns) input_ns = evt.common.timestamp;
+				}
 				//handle resizing:
 				if (evt.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
 					on_resize();
@@ -151,51 +479,194 @@ int main(int argc, char **argv) {
 					// mode handled it; great
 				} else if (evt.type == SDL_EVENT_QUIT) {
 					Mode::set_current(nullptr);
-					break;
 				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_PRINTSCREEN) {
-					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GetWindowSizeInPixels(Mode::window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
+					//(capture needs the OpenGL context, so is requested along with the next frame)
+					if (SDL_GetModState() & SDL_KMOD_SHIFT) {
+						// --- continuous capture toggle ---
+						commands.emplace_back([&capture_sequence](){
+							if (Capture::recording()) Capture::stop_sequence();
+							else Capture::start_sequence(capture_sequence);
+						});
+					} else {
+						// --- screenshot key ---
+						// (captured asynchronously at the end of the next frame)
+						commands.emplace_back([](){
+							Capture::screenshot("screenshot.png");
+						});
 					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
 				}
+			};
+
+			static SDL_Event evt;
+			while (SDL_PollEvent(&evt)) {
+				if (Replay::playing()) {
+					//while replaying, input comes from the recording; only resizing + quitting come from SDL:
+					if (evt.type != SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED && evt.type != SDL_EVENT_QUIT) continue;
+				} else {
+					//(events must be recorded before being handled, since handling may draw random seeds)
+					Replay::event(evt);
+				}
+				handle(evt);
+				if (!Mode::current) break;
+			}
+			while (Replay::playing() && Mode::current && Replay::next_event(&evt)) {
+				handle(evt);
 			}
 			if (!Mode::current) break;
 		}
 
-		{ //(2) call the current mode's "update" function to deal with elapsed time:
+		{ //(2) call the current mode's "fixed_update" and "update" functions to deal with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 			previous_time = current_time;
 
+			if (Replay::playing()) {
+				//replay as fast as possible, but simulate with the recorded times:
+				if (!Replay::next_frame(&elapsed)) {
+					Mode::set_current(nullptr);
+					break;
+				}
+			} else {
+				Replay::frame(elapsed);
+			}
+
+			if (Mode::tick_rate > 0.0f) {
+				//advance simulation in fixed steps, carrying leftover time to the next frame:
+				float step = 1.0f / Mode::tick_rate;
+				tick_accumulator += elapsed;
+				uint32_t ticks = 0;
+				while (tick_accumulator >= step && ticks < Mode::max_ticks && Mode::current) {
+					Mode::current->fixed_update(step);
+					tick_accumulator -= step;
+					ticks += 1;
+				}
+				if (!Mode::current) break;
+
+				//if simulation can't keep up, drop time rather than spiral further behind:
+				if (tick_accumulator >= step) {
+					float keep = std::fmod(tick_accumulator, step);
+					dropped_time += tick_accumulator - keep;
+					dropped_frames += 1;
+					tick_accumulator = keep;
+				}
+				Mode::tick_alpha = tick_accumulator / step;
+			}
+
 			//if frames are taking a very long time to process,
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
+			if (Mode::tick_rate <= 0.0f) {
+				//(no fixed rate: one variable-length step per frame)
+				Mode::current->fixed_update(elapsed);
+				if (!Mode::current) break;
+				Mode::tick_alpha = 1.0f;
+			}
+
 			Mode::current->update(elapsed);
 			if (!Mode::current) break;
 		}
 
-		{ //(3) call the current mode's "draw" function to produce output:
-		
-			Mode::current->draw(drawable_size);
+		{ //log audio callbacks that ran late or too long (so they show up in logs from players' machines):
+			auto now = std::chrono::steady_clock::now();
+			if (now - audio_check_time >= std::chrono::seconds(1)) {
+				Sound::MixStats stats = Sound::mix_stats(std::chrono::duration< float >(now - audio_check_time).count());
+				audio_check_time = now;
+				if (stats.underruns || stats.overruns) {
+					std::cout << "Audio: " << stats.underruns << " underrun(s) and " << stats.overruns << " overrun(s) in the last " << stats.seconds << " s (callback max " << stats.duration_max_us << " us, max load " << stats.load_max * 100.0f << "%, up to " << stats.voices_max << " playing samples)." << std::endl;
+				}
+			}
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(Mode::window);
+		{ //(3) draw + present the frame:
+			RenderFrame frame;
+			frame.commands = std::move(commands);
+			frame.drawable_size = drawable_size;
+			frame.input_ns = input_ns;
+			commands.clear();
+			input_ns = 0;
+
+			glm::uvec2 size = drawable_size;
+			if (!render_thread) {
+				//patch in any assets that were edited on disk:
+				HotReload::update();
+
+				frame.draw = [size](){ Mode::current->draw(size); };
+				present(frame);
+			} else {
+				//reloading assets changes data the update loop reads, so do it while this thread waits:
+				if (HotReload::pending()) {
+					RenderFrame reload;
+					reload.commands.emplace_back(HotReload::update);
+					submit(std::move(reload));
+					wait_idle();
+				}
+
+				//(the previous frame must have been taken before preparing the next; see Mode::prepare_draw)
+				wait_mailbox();
+				if (prepared_mode != Mode::current) {
+					//frames from the previous mode must be finished before it can be released:
+					wait_idle();
+					prepared_mode = Mode::current;
+				}
+				frame.draw = Mode::current->prepare_draw(size);
+				if (frame.draw) {
+					submit(std::move(frame));
+				} else {
+					//mode can't prepare frames in advance, so draw on the render thread while this thread waits:
+					frame.draw = [size](){ Mode::current->draw(size); };
+					submit(std::move(frame));
+					wait_idle();
+				}
+			}
+		}
+	}
+
+	if (render_thread) {
+		{
+			std::unique_lock< std::mutex > lock(render_mutex);
+			render_quit = true;
+			render_cv.notify_all();
+		}
+		renderer.join();
+		prepared_mode.reset();
+		SDL_GL_MakeCurrent(Mode::window, context);
+		Jobs::set_main_thread();
 	}
 
+	if (present_stats.frames > 1) {
+		float seconds = std::chrono::duration< float >(present_stats.last - present_stats.first).count();
+		std::cout << "Presented " << present_stats.frames << " frames" << (render_thread ? " (with render thread)" : "");
+		if (seconds > 0.0f) std::cout << " at " << (present_stats.frames - 1) / seconds << " fps";
+		if (present_stats.input_frames) {
+			std::cout << "; input-to-present latency " << present_stats.input_latency_total / present_stats.input_frames * 1000.0 << " ms average, " << present_stats.input_latency_max * 1000.0 << " ms max";
+		}
+		std::cout << "." << std::endl;
+	}
+
+	update_allocations.report(render_thread ? "update thread" : "main thread");
+	render_allocations.report("render thread");
+	std::cout << "Frame arena high water mark: " << FrameArena::high_water() / 1024 << " KiB";
+	if (render_thread) std::cout << " (update thread), " << render_arena_high_water / 1024 << " KiB (render thread)";
+	std::cout << "." << std::endl;
+
+	Sound::MixTimes mix_times = Sound::mix_times();
+	if (mix_times.callbacks) {
+		std::cout << "Audio mixing took " << mix_times.mix_seconds / mix_times.callbacks * 1.0e6 << " us per callback on average (" << mix_times.bus_seconds / mix_times.callbacks * 1.0e6 << " us in the bus graph), over " << mix_times.callbacks << " callbacks with " << double(mix_times.voices) / mix_times.callbacks << " playing samples on average (" << double(mix_times.virtual_voices) / mix_times.callbacks << " virtual, " << double(mix_times.silent_voices) / mix_times.callbacks << " skipped as silent); " << mix_times.underruns << " underrun(s), " << mix_times.overruns << " overrun(s)." << std::endl;
+	}
+	RealtimeCheck::report();
+
+	if (dropped_frames) {
+		std::cout << "Simulation fell behind on " << dropped_frames << " frames (" << dropped_time << " s dropped); consider a lower --tick-rate or higher --max-ticks." << std::endl;
+	}
 
 	//------------  teardown ------------
+	Replay::finish();
+	Jobs::shutdown();
+	HotReload::shutdown();
+	Capture::shutdown();
+	Textures::shutdown();
 	Sound::shutdown();
 
 	SDL_GL_DestroyContext(context);